@@ -0,0 +1,125 @@
+#ifndef ASSETMANAGER_H
+#define ASSETMANAGER_H
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "shader.h"
+#include "mesh.h"
+#include "model.h"
+#include "modelStreamer.h"
+#include "textureCache.h"
+#include "mappedFile.h"
+
+/*
+ * hands out shared handles to models, textures and shaders, keyed by canonical path so
+ * "assets/a.obj" and "./assets/../assets/a.obj" are the same asset
+ *
+ * the manager only keeps weak references: an asset is loaded the first time it's asked
+ * for, shared by everyone asking for it after that, and freed when the last handle
+ * drops. asking again after that loads it again
+ *
+ * textures are handed straight on to TextureCache, which also shares them between models
+ *
+ * gl thread only, the handles' deleters call into gl
+ */
+
+class AssetManager {
+  public:
+    AssetManager();
+
+    AssetManager(const AssetManager&) = delete;
+    AssetManager& operator=(const AssetManager&) = delete;
+
+    static AssetManager& shared();
+
+    // with a streamer, models come back straight away and stream in, otherwise model() blocks
+    void setStreamer(ModelStreamer* streamer);
+
+    // the same file with a different layout is a different model, the vertex buffers differ
+    std::shared_ptr<Model>   model(std::string path, VertexLayout layout = VERTEX_LAYOUT_FLOAT);
+    // the texture's type is left empty, it's up to whoever binds it
+    std::shared_ptr<Texture> texture(std::string path);
+    std::shared_ptr<Shader>  shader(std::string vertexPath, std::string fragmentPath);
+
+    // assets that are still referenced somewhere
+    uint residentCount();
+
+  private:
+    ModelStreamer* _streamer;
+
+    std::unordered_map<std::string, std::weak_ptr<Model>>   _models;
+    std::unordered_map<std::string, std::weak_ptr<Shader>>  _shaders;
+
+    template <typename T>
+    static std::shared_ptr<T> find(std::unordered_map<std::string, std::weak_ptr<T>>& assets, const std::string& key);
+    template <typename T>
+    static void prune(std::unordered_map<std::string, std::weak_ptr<T>>& assets);
+};
+
+AssetManager::AssetManager()
+  : _streamer(nullptr) {
+}
+
+AssetManager& AssetManager::shared() {
+  static AssetManager manager;
+  return manager;
+}
+
+void AssetManager::setStreamer(ModelStreamer* streamer) {
+  _streamer = streamer;
+}
+
+template <typename T>
+std::shared_ptr<T> AssetManager::find(std::unordered_map<std::string, std::weak_ptr<T>>& assets, const std::string& key) {
+  auto found = assets.find(key);
+  if (found == assets.end()) return nullptr;
+  return found->second.lock();
+}
+
+// drops entries whose asset is gone, run before adding so the maps don't grow without bound
+template <typename T>
+void AssetManager::prune(std::unordered_map<std::string, std::weak_ptr<T>>& assets) {
+  for (auto it = assets.begin(); it != assets.end();) {
+    if (it->second.expired()) it = assets.erase(it);
+    else                      ++it;
+  }
+}
+
+std::shared_ptr<Model> AssetManager::model(std::string path, VertexLayout layout) {
+  std::string key = canonicalPath(path) + (layout == VERTEX_LAYOUT_PACKED ? "#packed" : "");
+  if (std::shared_ptr<Model> model = find(_models, key)) return model;
+
+  // Model frees its own gl objects, so a plain shared_ptr is enough
+  std::shared_ptr<Model> model = _streamer ? _streamer->load(path, layout) : std::make_shared<Model>(path, layout);
+  prune(_models);
+  _models[key] = model;
+  return model;
+}
+
+std::shared_ptr<Texture> AssetManager::texture(std::string path) {
+  return TextureCache::shared().acquire(path);
+}
+
+std::shared_ptr<Shader> AssetManager::shader(std::string vertexPath, std::string fragmentPath) {
+  std::string key = canonicalPath(vertexPath) + "|" + canonicalPath(fragmentPath);
+  if (std::shared_ptr<Shader> shader = find(_shaders, key)) return shader;
+
+  // Shader gets copied around by value, so deleting the program is left to the last handle
+  std::shared_ptr<Shader> shader(new Shader(vertexPath.c_str(), fragmentPath.c_str()), [](Shader* shader) {
+    GLState::shared().deleteProgram(shader->ID);
+    delete shader;
+  });
+
+  prune(_shaders);
+  _shaders[key] = shader;
+  return shader;
+}
+
+uint AssetManager::residentCount() {
+  prune(_models);
+  prune(_shaders);
+  return _models.size() + TextureCache::shared().stats().resident + _shaders.size();
+}
+
+#endif /* ASSETMANAGER_H */
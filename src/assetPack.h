@@ -0,0 +1,388 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include "mappedFile.h"
+#include "hash.h"
+#include "lz.h"
+
+/*
+ * every mesh, texture and shader in one file, mapped once at startup, so a cold start is
+ * one open and one mmap instead of one per file (see `make pack`)
+ *
+ *   AssetPackHeader
+ *   displacements  uint32 per bucket
+ *   entries        AssetPackEntry per file, in the slot the perfect hash puts it
+ *   names          the packed paths, for checking a hit and for listing
+ *   data           each file ASSET_PACK_ALIGNMENT aligned, stored as is or lz compressed
+ *
+ * the directory is a perfect hash: a path's FNV hash picks its bucket, the bucket's
+ * displacement reseeds the hash, and that lands on the path's own slot, so a lookup is
+ * two hashes and one string compare and never probes
+ *
+ * while a pack is open it is the FileSource, so MappedFile::open serves packed files as
+ * views straight into the mapping (compressed ones are decompressed into a buffer the
+ * MappedFile owns) and anything that isn't packed still comes off the disk. paths are
+ * keyed relative to the working directory, "./assets/../assets/a.obj" is "assets/a.obj"
+ */
+
+#define ASSET_PACK_PATH      "assets.pack"
+#define ASSET_PACK_MAGIC     "LOGLPACK"
+#define ASSET_PACK_VERSION   1
+#define ASSET_PACK_ALIGNMENT 64
+// an entry is only stored compressed if that saves at least this much of it
+#define ASSET_PACK_MIN_SAVING 0.25
+
+#define ASSET_PACK_COMPRESSED 1
+
+struct AssetPackHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t bucketCount;
+  uint32_t padding;
+  uint64_t displacementOffset;
+  uint64_t entryOffset;
+  uint64_t nameOffset;
+};
+
+struct AssetPackEntry {
+  uint64_t keyHash;
+  uint64_t offset;
+  // size of the file, and of what's in the pack for it
+  uint64_t size;
+  uint64_t storedSize;
+  // of the file when it was packed, so caches keyed on it stay valid
+  int64_t  modified;
+  uint32_t nameOffset;
+  uint32_t nameLength;
+  uint32_t flags;
+  uint32_t padding[3];
+};
+
+struct AssetPackStats {
+  uint   hits;
+  uint   misses;
+  size_t bytesServed;
+  size_t bytesDecompressed;
+};
+
+static std::string assetPackKey(const std::string& path) {
+  std::filesystem::path key = std::filesystem::path(path).lexically_normal();
+  if (key.is_absolute()) {
+    std::error_code error;
+    std::filesystem::path cwd = std::filesystem::current_path(error);
+    if (!error) key = key.lexically_relative(cwd);
+  }
+  return key.generic_string();
+}
+
+// splitmix64, spreads the reseeded hash over the slots
+static uint64_t assetPackMix(uint64_t hash, uint32_t seed) {
+  uint64_t z = hash + (uint64_t)(seed + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+class AssetPack : public FileSource {
+  public:
+    AssetPack() {}
+    ~AssetPack();
+
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    static AssetPack& shared();
+
+    // maps the pack and starts serving files from it, false (and loose files it is) if
+    // there's no usable pack at the path
+    bool open(const std::string& path = ASSET_PACK_PATH);
+    void close();
+
+    bool isOpen() const;
+    bool contains(const std::string& path);
+    std::vector<std::string> paths();
+
+    bool open(const std::string& path, MappedFile& file) override;
+    bool stat(const std::string& path, int64_t& size, int64_t& modified) override;
+
+    AssetPackStats stats() const;
+
+  private:
+    MappedFile _file;
+    const AssetPackHeader* _header = nullptr;
+    const uint32_t*        _displacements = nullptr;
+    const AssetPackEntry*  _entries = nullptr;
+    const char*            _names = nullptr;
+
+    // bumped from the loading threads
+    std::atomic<uint>   _hits{0}, _misses{0};
+    std::atomic<size_t> _bytesServed{0}, _bytesDecompressed{0};
+
+    const AssetPackEntry* find(const std::string& path);
+};
+
+AssetPack::~AssetPack() {
+  close();
+}
+
+AssetPack& AssetPack::shared() {
+  static AssetPack pack;
+  return pack;
+}
+
+bool AssetPack::open(const std::string& path) {
+  close();
+  // the pack itself always comes off the disk
+  if (!_file.open(path)) return false;
+
+  const unsigned char* data = _file.data();
+  size_t size = _file.size();
+  const AssetPackHeader* header = (const AssetPackHeader*)data;
+
+  if (size < sizeof(AssetPackHeader) || std::memcmp(header->magic, ASSET_PACK_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != ASSET_PACK_VERSION || header->bucketCount == 0 ||
+      header->displacementOffset + header->bucketCount * sizeof(uint32_t) > size ||
+      header->entryOffset + header->entryCount * sizeof(AssetPackEntry) > size || header->nameOffset > size) {
+    std::cout << "ERROR::ASSETPACK::INVALID '" << path << "'" << std::endl;
+    _file.close();
+    return false;
+  }
+
+  const AssetPackEntry* entries = (const AssetPackEntry*)(data + header->entryOffset);
+  for (uint i = 0; i < header->entryCount; i++) {
+    if (entries[i].offset + entries[i].storedSize > size ||
+        header->nameOffset + entries[i].nameOffset + entries[i].nameLength > size) {
+      std::cout << "ERROR::ASSETPACK::TRUNCATED '" << path << "'" << std::endl;
+      _file.close();
+      return false;
+    }
+  }
+
+  _header        = header;
+  _displacements = (const uint32_t*)(data + header->displacementOffset);
+  _entries       = entries;
+  _names         = (const char*)(data + header->nameOffset);
+  fileSource() = this;
+
+  std::cout << "INFO::ASSETPACK::" << header->entryCount << " files from '" << path << "'" << std::endl;
+  return true;
+}
+
+void AssetPack::close() {
+  if (fileSource() == this) fileSource() = nullptr;
+  _file.close();
+  _header = nullptr;
+}
+
+bool AssetPack::isOpen() const {
+  return _header != nullptr;
+}
+
+const AssetPackEntry* AssetPack::find(const std::string& path) {
+  if (!_header || _header->entryCount == 0) return nullptr;
+
+  std::string key = assetPackKey(path);
+  uint64_t hash = hashBytes(key.data(), key.size());
+  uint32_t displacement = _displacements[hash % _header->bucketCount];
+  const AssetPackEntry& entry = _entries[assetPackMix(hash, displacement) % _header->entryCount];
+
+  // every path lands on some slot, only the one it was packed into has its name
+  if (entry.keyHash != hash || entry.nameLength != key.size() ||
+      std::memcmp(_names + entry.nameOffset, key.data(), key.size()) != 0) return nullptr;
+  return &entry;
+}
+
+bool AssetPack::contains(const std::string& path) {
+  return find(path) != nullptr;
+}
+
+std::vector<std::string> AssetPack::paths() {
+  std::vector<std::string> paths;
+  for (uint i = 0; _header && i < _header->entryCount; i++)
+    paths.push_back(std::string(_names + _entries[i].nameOffset, _entries[i].nameLength));
+  return paths;
+}
+
+bool AssetPack::open(const std::string& path, MappedFile& file) {
+  const AssetPackEntry* entry = find(path);
+  if (!entry) {
+    _misses++;
+    return false;
+  }
+
+  _hits++;
+  _bytesServed += entry->size;
+  const unsigned char* stored = _file.data() + entry->offset;
+  if (!(entry->flags & ASSET_PACK_COMPRESSED)) {
+    file.openView(stored, entry->size);
+    return true;
+  }
+
+  std::vector<unsigned char> bytes(entry->size);
+  if (!lzDecompress(stored, entry->storedSize, bytes.data(), bytes.size())) {
+    std::cout << "ERROR::ASSETPACK::CORRUPT '" << path << "'" << std::endl;
+    return false;
+  }
+  _bytesDecompressed += entry->size;
+  file.openBytes(std::move(bytes));
+  return true;
+}
+
+bool AssetPack::stat(const std::string& path, int64_t& size, int64_t& modified) {
+  const AssetPackEntry* entry = find(path);
+  if (!entry) return false;
+  size     = entry->size;
+  modified = entry->modified;
+  return true;
+}
+
+AssetPackStats AssetPack::stats() const {
+  return { _hits, _misses, _bytesServed, _bytesDecompressed };
+}
+
+// builds a pack out of `files` (paths relative to the working directory), compressing
+// the entries it's worth it for if `compress` is set
+bool writeAssetPack(const std::string& path, const std::vector<std::string>& files, bool compress) {
+  struct Packed {
+    std::string key;
+    uint64_t    hash;
+    std::vector<uint8_t> stored;
+    AssetPackEntry entry;
+  };
+
+  std::vector<Packed> packed;
+  for (const std::string& file : files) {
+    MappedFile source;
+    // the files going in, not whatever pack might already be open
+    FileSource* previous = fileSource();
+    fileSource() = nullptr;
+    bool opened = source.open(file);
+    int64_t modified = fileModifiedTime(file);
+    fileSource() = previous;
+    if (!opened) {
+      std::cout << "WARNING::ASSETPACK::UNREADABLE '" << file << "'" << std::endl;
+      continue;
+    }
+
+    Packed item = {};
+    item.key  = assetPackKey(file);
+    item.hash = hashBytes(item.key.data(), item.key.size());
+    item.entry.keyHash  = item.hash;
+    item.entry.size     = source.size();
+    item.entry.modified = modified;
+
+    std::vector<uint8_t> compressed;
+    if (compress) compressed = lzCompress(source.data(), source.size());
+    if (compress && compressed.size() <= source.size() * (1.0 - ASSET_PACK_MIN_SAVING)) {
+      item.stored = std::move(compressed);
+      item.entry.flags = ASSET_PACK_COMPRESSED;
+    } else {
+      item.stored.assign(source.data(), source.data() + source.size());
+    }
+    item.entry.storedSize = item.stored.size();
+    packed.push_back(std::move(item));
+  }
+
+  // hash and displace: the fullest buckets pick their displacement first, while most
+  // slots are still free
+  uint32_t entryCount  = packed.size();
+  uint32_t bucketCount = std::max(1u, entryCount);
+  std::vector<std::vector<uint32_t>> buckets(bucketCount);
+  for (uint32_t i = 0; i < entryCount; i++) buckets[packed[i].hash % bucketCount].push_back(i);
+
+  std::vector<uint32_t> order(bucketCount);
+  for (uint32_t i = 0; i < bucketCount; i++) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+  std::vector<uint32_t> displacements(bucketCount, 0);
+  std::vector<int64_t> slots(entryCount, -1);
+  for (uint32_t bucket : order) {
+    if (buckets[bucket].empty()) break;
+
+    for (uint32_t displacement = 0;; displacement++) {
+      std::vector<uint32_t> taken;
+      bool fits = true;
+      for (uint32_t i : buckets[bucket]) {
+        uint32_t slot = assetPackMix(packed[i].hash, displacement) % entryCount;
+        if (slots[slot] >= 0 || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+          fits = false;
+          break;
+        }
+        taken.push_back(slot);
+      }
+      if (!fits) continue;
+
+      for (uint32_t k = 0; k < taken.size(); k++) slots[taken[k]] = buckets[bucket][k];
+      displacements[bucket] = displacement;
+      break;
+    }
+  }
+
+  auto align = [](uint64_t offset) { return (offset + ASSET_PACK_ALIGNMENT - 1) & ~(uint64_t)(ASSET_PACK_ALIGNMENT - 1); };
+
+  AssetPackHeader header = {};
+  std::memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+  header.version     = ASSET_PACK_VERSION;
+  header.entryCount  = entryCount;
+  header.bucketCount = bucketCount;
+  header.displacementOffset = sizeof(AssetPackHeader);
+  header.entryOffset = align(header.displacementOffset + bucketCount * sizeof(uint32_t));
+  header.nameOffset  = header.entryOffset + entryCount * sizeof(AssetPackEntry);
+
+  std::string names;
+  for (Packed& item : packed) {
+    item.entry.nameOffset = names.size();
+    item.entry.nameLength = item.key.size();
+    names += item.key;
+  }
+
+  uint64_t offset = align(header.nameOffset + names.size());
+  std::vector<AssetPackEntry> entries(entryCount);
+  for (uint32_t slot = 0; slot < entryCount; slot++) {
+    Packed& item = packed[slots[slot]];
+    item.entry.offset = offset;
+    offset = align(offset + item.stored.size());
+    entries[slot] = item.entry;
+  }
+
+  // same temporary and rename as the mesh cache, a crash never leaves half a pack behind
+  std::string tempPath = path + ".tmp";
+  std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+  if (!out) return false;
+
+  auto pad = [&out](uint64_t to) {
+    static const char zeros[ASSET_PACK_ALIGNMENT] = {};
+    out.write(zeros, to - (uint64_t)out.tellp());
+  };
+
+  out.write((const char*)&header, sizeof(header));
+  out.write((const char*)displacements.data(), displacements.size() * sizeof(uint32_t));
+  pad(header.entryOffset);
+  out.write((const char*)entries.data(), entries.size() * sizeof(AssetPackEntry));
+  out.write(names.data(), names.size());
+  for (const AssetPackEntry& entry : entries) {
+    pad(entry.offset);
+    const Packed& item = packed[slots[&entry - entries.data()]];
+    out.write((const char*)item.stored.data(), item.stored.size());
+  }
+
+  out.close();
+  if (!out || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+    std::remove(tempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+#endif /* ASSETPACK_H */
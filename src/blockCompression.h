@@ -0,0 +1,481 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * 4x4 block encoders and decoders for the cooked texture formats
+ *
+ *   bc1   rgb, 8 bytes:  two rgb565 endpoints and a 2 bit index per pixel
+ *   bc3   rgba, 16 bytes: a bc4 block for alpha, then a bc1 block for colour
+ *   bc5   rg, 16 bytes:  two bc4 blocks (a bc4 block is two 8 bit endpoints and 3 bit indices)
+ *   etc2  rgb, 8 bytes:  written with the etc1 subset (individual and differential
+ *                        modes), which every etc2 decoder reads the same way
+ *
+ * the encoders aim for decent quality at speed, a 4096x4096 texture should cook in
+ * about a second on a few cores. the decoders are only used to check the encoders'
+ * output (see cookTexture's psnr report), the gpu does the real decoding
+ */
+
+#define BC1_BLOCK_BYTES  8
+#define BC3_BLOCK_BYTES  16
+#define BC5_BLOCK_BYTES  16
+#define ETC2_BLOCK_BYTES 8
+
+// 4x4 pixels, rgba8, row major
+struct ColorBlock {
+  uint8_t rgba[16][4];
+};
+
+static void writeLittleEndian(uint8_t* out, uint64_t value, uint bytes) {
+  for (uint i = 0; i < bytes; i++) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t readLittleEndian(const uint8_t* in, uint bytes) {
+  uint64_t value = 0;
+  for (uint i = 0; i < bytes; i++) value |= (uint64_t)in[i] << (8 * i);
+  return value;
+}
+
+// ---------- BC1
+
+static uint16_t packRgb565(float r, float g, float b) {
+  int r5 = (int)std::lround(std::clamp(r, 0.0f, 255.0f) * 31.0f / 255.0f);
+  int g6 = (int)std::lround(std::clamp(g, 0.0f, 255.0f) * 63.0f / 255.0f);
+  int b5 = (int)std::lround(std::clamp(b, 0.0f, 255.0f) * 31.0f / 255.0f);
+  return (uint16_t)(r5 << 11 | g6 << 5 | b5);
+}
+
+static void unpackRgb565(uint16_t color, int rgb[3]) {
+  int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// colour block palette, bc3 colour blocks are always read in four colour mode
+static void bc1Palette(uint16_t c0, uint16_t c1, int palette[4][3], bool fourColor) {
+  unpackRgb565(c0, palette[0]);
+  unpackRgb565(c1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    if (c0 > c1 || fourColor) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+}
+
+// nearest palette entry for every pixel as packed 2 bit indices, error gets the summed squared error
+static uint32_t bc1SelectIndices(const ColorBlock& block, const int palette[4][3], uint& error) {
+  uint32_t indices = 0;
+  error = 0;
+
+#ifdef __SSE2__
+  // four pixels at a time: (r, g) pairs and (b, 0) pairs as 16 bit lanes, so one madd
+  // per pair gives r*r + g*g and b*b as 32 bit sums
+  __m128i prg[4], pb[4];
+  for (int p = 0; p < 4; p++) {
+    prg[p] = _mm_set1_epi32(palette[p][1] << 16 | palette[p][0]);
+    pb[p]  = _mm_set1_epi32(palette[p][2]);
+  }
+
+  for (int group = 0; group < 4; group++) {
+    const uint8_t (*px)[4] = &block.rgba[group * 4];
+    __m128i rg = _mm_setr_epi16(px[0][0], px[0][1], px[1][0], px[1][1], px[2][0], px[2][1], px[3][0], px[3][1]);
+    __m128i b  = _mm_setr_epi16(px[0][2], 0, px[1][2], 0, px[2][2], 0, px[3][2], 0);
+
+    __m128i bestDistance = _mm_set1_epi32(INT_MAX);
+    __m128i bestIndex    = _mm_setzero_si128();
+    for (int p = 0; p < 4; p++) {
+      __m128i drg = _mm_sub_epi16(rg, prg[p]);
+      __m128i db  = _mm_sub_epi16(b, pb[p]);
+      __m128i distance = _mm_add_epi32(_mm_madd_epi16(drg, drg), _mm_madd_epi16(db, db));
+
+      __m128i closer = _mm_cmplt_epi32(distance, bestDistance);
+      bestDistance = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, bestDistance));
+      bestIndex    = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+    }
+
+    alignas(16) int32_t index[4], distance[4];
+    _mm_store_si128((__m128i*)index, bestIndex);
+    _mm_store_si128((__m128i*)distance, bestDistance);
+    for (int i = 0; i < 4; i++) {
+      indices |= (uint32_t)index[i] << (2 * (group * 4 + i));
+      error += distance[i];
+    }
+  }
+#else
+  for (int i = 0; i < 16; i++) {
+    uint best = UINT_MAX, bestIndex = 0;
+    for (int p = 0; p < 4; p++) {
+      int dr = block.rgba[i][0] - palette[p][0];
+      int dg = block.rgba[i][1] - palette[p][1];
+      int db = block.rgba[i][2] - palette[p][2];
+      uint distance = dr * dr + dg * dg + db * db;
+      if (distance < best) {
+        best = distance;
+        bestIndex = p;
+      }
+    }
+    indices |= bestIndex << (2 * i);
+    error += best;
+  }
+#endif
+
+  return indices;
+}
+
+struct Bc1Candidate {
+  uint16_t c0, c1;
+  uint32_t indices;
+  uint     error;
+};
+
+// orders the endpoints for four colour mode and picks indices for them
+static Bc1Candidate bc1Try(const ColorBlock& block, uint16_t a, uint16_t b) {
+  Bc1Candidate candidate;
+  candidate.c0 = std::max(a, b);
+  candidate.c1 = std::min(a, b);
+
+  int palette[4][3];
+  bc1Palette(candidate.c0, candidate.c1, palette, true);
+  // equal endpoints would read as three colour mode, where only index 0 is still the same colour
+  if (candidate.c0 == candidate.c1) {
+    for (int p = 1; p < 4; p++) std::memcpy(palette[p], palette[0], sizeof(palette[0]));
+  }
+
+  candidate.indices = bc1SelectIndices(block, palette, candidate.error);
+  if (candidate.c0 == candidate.c1) candidate.indices = 0;
+  return candidate;
+}
+
+// endpoints from the colours' principal axis, then one least squares refit to the chosen indices
+void encodeBc1(const ColorBlock& block, uint8_t* out) {
+  float mean[3] = { 0, 0, 0 };
+  for (int i = 0; i < 16; i++)
+    for (int c = 0; c < 3; c++) mean[c] += block.rgba[i][c] / 16.0f;
+
+  float cov[6] = { 0, 0, 0, 0, 0, 0 };
+  for (int i = 0; i < 16; i++) {
+    float d[3] = { block.rgba[i][0] - mean[0], block.rgba[i][1] - mean[1], block.rgba[i][2] - mean[2] };
+    cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+    cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+  }
+
+  // power iteration, converges plenty in a few steps for a 3x3
+  float axis[3] = { 1.0f, 1.0f, 1.0f };
+  for (int iteration = 0; iteration < 6; iteration++) {
+    float next[3] = {
+      cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+      cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+      cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+    };
+    float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+    if (length < 1e-6f) break;
+    for (int c = 0; c < 3; c++) axis[c] = next[c] / length;
+  }
+
+  float lo = 1e9f, hi = -1e9f;
+  for (int i = 0; i < 16; i++) {
+    float t = 0.0f;
+    for (int c = 0; c < 3; c++) t += (block.rgba[i][c] - mean[c]) * axis[c];
+    lo = std::min(lo, t);
+    hi = std::max(hi, t);
+  }
+
+  Bc1Candidate best = bc1Try(block,
+      packRgb565(mean[0] + axis[0] * hi, mean[1] + axis[1] * hi, mean[2] + axis[2] * hi),
+      packRgb565(mean[0] + axis[0] * lo, mean[1] + axis[1] * lo, mean[2] + axis[2] * lo));
+
+  if (best.c0 != best.c1) {
+    // weight of c0 for each index in four colour mode
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0, ab = 0, bb = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+      float a = weights[(best.indices >> (2 * i)) & 3], b = 1.0f - a;
+      aa += a * a; ab += a * b; bb += b * b;
+      for (int c = 0; c < 3; c++) {
+        ax[c] += a * block.rgba[i][c];
+        bx[c] += b * block.rgba[i][c];
+      }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) > 1e-6f) {
+      float e0[3], e1[3];
+      for (int c = 0; c < 3; c++) {
+        e0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+        e1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+      }
+      Bc1Candidate refit = bc1Try(block, packRgb565(e0[0], e0[1], e0[2]), packRgb565(e1[0], e1[1], e1[2]));
+      if (refit.error < best.error) best = refit;
+    }
+  }
+
+  writeLittleEndian(out,     best.c0, 2);
+  writeLittleEndian(out + 2, best.c1, 2);
+  writeLittleEndian(out + 4, best.indices, 4);
+}
+
+void decodeBc1(const uint8_t* in, ColorBlock& block, bool fourColor = false) {
+  uint16_t c0 = readLittleEndian(in, 2), c1 = readLittleEndian(in + 2, 2);
+  uint32_t indices = readLittleEndian(in + 4, 4);
+
+  int palette[4][3];
+  bc1Palette(c0, c1, palette, fourColor);
+  for (int i = 0; i < 16; i++) {
+    int p = (indices >> (2 * i)) & 3;
+    for (int c = 0; c < 3; c++) block.rgba[i][c] = palette[p][c];
+    block.rgba[i][3] = (!fourColor && c0 <= c1 && p == 3) ? 0 : 255;
+  }
+}
+
+// ---------- BC4, the building block of bc3 alpha and bc5
+
+// always eight value mode (a0 > a1), the values are evenly spaced so the nearest one is a division away
+void encodeBc4(const uint8_t values[16], uint8_t* out) {
+  uint8_t lo = 255, hi = 0;
+  for (int i = 0; i < 16; i++) {
+    lo = std::min(lo, values[i]);
+    hi = std::max(hi, values[i]);
+  }
+
+  uint64_t indices = 0;
+  if (hi > lo) {
+    for (int i = 0; i < 16; i++) {
+      // 0 is a0 (hi), 7 is a1 (lo), the stored index order puts the two endpoints first
+      int step = (int)std::lround((hi - values[i]) * 7.0f / (hi - lo));
+      uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+      indices |= index << (3 * i);
+    }
+  }
+
+  out[0] = hi;
+  out[1] = lo;
+  writeLittleEndian(out + 2, indices, 6);
+}
+
+void decodeBc4(const uint8_t* in, uint8_t values[16]) {
+  int a0 = in[0], a1 = in[1];
+  int palette[8] = { a0, a1 };
+  if (a0 > a1) {
+    for (int i = 2; i < 8; i++) palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+  } else {
+    for (int i = 2; i < 6; i++) palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indices = readLittleEndian(in + 2, 6);
+  for (int i = 0; i < 16; i++) values[i] = palette[(indices >> (3 * i)) & 7];
+}
+
+// ---------- BC3 and BC5
+
+void encodeBc3(const ColorBlock& block, uint8_t* out) {
+  uint8_t alpha[16];
+  for (int i = 0; i < 16; i++) alpha[i] = block.rgba[i][3];
+  encodeBc4(alpha, out);
+  encodeBc1(block, out + 8);
+}
+
+void decodeBc3(const uint8_t* in, ColorBlock& block) {
+  decodeBc1(in + 8, block, true);
+  uint8_t alpha[16];
+  decodeBc4(in, alpha);
+  for (int i = 0; i < 16; i++) block.rgba[i][3] = alpha[i];
+}
+
+void encodeBc5(const ColorBlock& block, uint8_t* out) {
+  uint8_t red[16], green[16];
+  for (int i = 0; i < 16; i++) {
+    red[i]   = block.rgba[i][0];
+    green[i] = block.rgba[i][1];
+  }
+  encodeBc4(red, out);
+  encodeBc4(green, out + 8);
+}
+
+void decodeBc5(const uint8_t* in, ColorBlock& block) {
+  uint8_t red[16], green[16];
+  decodeBc4(in, red);
+  decodeBc4(in + 8, green);
+  for (int i = 0; i < 16; i++) {
+    block.rgba[i][0] = red[i];
+    block.rgba[i][1] = green[i];
+    block.rgba[i][2] = 0;
+    block.rgba[i][3] = 255;
+  }
+}
+
+// ---------- ETC2 (etc1 subset)
+
+static const int etcModifiers[8][2] = {
+  { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+// the four colours a subblock's pixels choose from, in index order (+a, +b, -a, -b)
+static void etcSubblockPalette(const int base[3], int table, int palette[4][3]) {
+  const int offsets[4] = { etcModifiers[table][0], etcModifiers[table][1], -etcModifiers[table][0], -etcModifiers[table][1] };
+  for (int p = 0; p < 4; p++)
+    for (int c = 0; c < 3; c++) palette[p][c] = std::clamp(base[c] + offsets[p], 0, 255);
+}
+
+// pixel (x, y) of the block is in subblock 1 if it's in the right half, or the bottom half when flipped
+static int etcSubblock(int x, int y, bool flip) {
+  return flip ? (y >= 2) : (x >= 2);
+}
+
+struct EtcSubblockFit {
+  int      table;
+  uint     error;
+  uint32_t indices; // 2 bits per pixel, in block pixel order (i = y * 4 + x), only this subblock's set
+};
+
+static EtcSubblockFit etcFitSubblock(const ColorBlock& block, int subblock, bool flip, const int base[3]) {
+  EtcSubblockFit best = { 0, UINT_MAX, 0 };
+  for (int table = 0; table < 8; table++) {
+    int palette[4][3];
+    etcSubblockPalette(base, table, palette);
+
+    EtcSubblockFit fit = { table, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+      if (etcSubblock(i % 4, i / 4, flip) != subblock) continue;
+
+      uint nearest = UINT_MAX, index = 0;
+      for (int p = 0; p < 4; p++) {
+        int dr = block.rgba[i][0] - palette[p][0];
+        int dg = block.rgba[i][1] - palette[p][1];
+        int db = block.rgba[i][2] - palette[p][2];
+        uint distance = dr * dr + dg * dg + db * db;
+        if (distance < nearest) {
+          nearest = distance;
+          index = p;
+        }
+      }
+      fit.error += nearest;
+      fit.indices |= index << (2 * i);
+    }
+    if (fit.error < best.error) best = fit;
+  }
+  return best;
+}
+
+void encodeEtc2(const ColorBlock& block, uint8_t* out) {
+  uint64_t bestBits = 0;
+  uint bestError = UINT_MAX;
+
+  for (int flip = 0; flip < 2; flip++) {
+    float average[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+    for (int i = 0; i < 16; i++)
+      for (int c = 0; c < 3; c++) average[etcSubblock(i % 4, i / 4, flip)][c] += block.rgba[i][c] / 8.0f;
+
+    // differential mode (5 bit base, 3 bit signed delta) when the two averages are close enough, it's finer
+    int q5[2][3], q4[2][3];
+    bool differential = true;
+    for (int s = 0; s < 2; s++) {
+      for (int c = 0; c < 3; c++) {
+        q5[s][c] = (int)std::lround(average[s][c] * 31.0f / 255.0f);
+        q4[s][c] = (int)std::lround(average[s][c] * 15.0f / 255.0f);
+      }
+    }
+    for (int c = 0; c < 3; c++) {
+      int delta = q5[1][c] - q5[0][c];
+      if (delta < -4 || delta > 3) differential = false;
+    }
+
+    int base[2][3];
+    for (int s = 0; s < 2; s++) {
+      for (int c = 0; c < 3; c++)
+        base[s][c] = differential ? (q5[s][c] << 3 | q5[s][c] >> 2) : (q4[s][c] << 4 | q4[s][c]);
+    }
+
+    EtcSubblockFit fit0 = etcFitSubblock(block, 0, flip, base[0]);
+    EtcSubblockFit fit1 = etcFitSubblock(block, 1, flip, base[1]);
+    uint error = fit0.error + fit1.error;
+    if (error >= bestError) continue;
+
+    uint64_t bits = 0;
+    if (differential) {
+      for (int c = 0; c < 3; c++) {
+        bits |= (uint64_t)q5[0][c] << (59 - 8 * c);
+        bits |= (uint64_t)((q5[1][c] - q5[0][c]) & 7) << (56 - 8 * c);
+      }
+    } else {
+      for (int c = 0; c < 3; c++) {
+        bits |= (uint64_t)q4[0][c] << (60 - 8 * c);
+        bits |= (uint64_t)q4[1][c] << (56 - 8 * c);
+      }
+    }
+    bits |= (uint64_t)fit0.table << 37;
+    bits |= (uint64_t)fit1.table << 34;
+    bits |= (uint64_t)differential << 33;
+    bits |= (uint64_t)flip << 32;
+
+    // pixel indices are stored column major, most significant bits in the upper half
+    uint32_t indices = fit0.indices | fit1.indices;
+    for (int i = 0; i < 16; i++) {
+      uint index = (indices >> (2 * i)) & 3;
+      int bit = (i % 4) * 4 + i / 4;
+      bits |= (uint64_t)(index >> 1) << (16 + bit);
+      bits |= (uint64_t)(index & 1) << bit;
+    }
+
+    bestBits = bits;
+    bestError = error;
+  }
+
+  // etc blocks are big endian
+  for (int i = 0; i < 8; i++) out[i] = (uint8_t)(bestBits >> (56 - 8 * i));
+}
+
+// decodes the etc1 subset only, which is all encodeEtc2 writes
+void decodeEtc2(const uint8_t* in, ColorBlock& block) {
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; i++) bits = bits << 8 | in[i];
+
+  bool differential = (bits >> 33) & 1;
+  bool flip = (bits >> 32) & 1;
+  int tables[2] = { (int)(bits >> 37) & 7, (int)(bits >> 34) & 7 };
+
+  int base[2][3];
+  for (int c = 0; c < 3; c++) {
+    if (differential) {
+      int b0 = (bits >> (59 - 8 * c)) & 31;
+      int delta = (bits >> (56 - 8 * c)) & 7;
+      int b1 = b0 + (delta >= 4 ? delta - 8 : delta);
+      base[0][c] = b0 << 3 | b0 >> 2;
+      base[1][c] = b1 << 3 | b1 >> 2;
+    } else {
+      int b0 = (bits >> (60 - 8 * c)) & 15;
+      int b1 = (bits >> (56 - 8 * c)) & 15;
+      base[0][c] = b0 << 4 | b0;
+      base[1][c] = b1 << 4 | b1;
+    }
+  }
+
+  int palette[2][4][3];
+  etcSubblockPalette(base[0], tables[0], palette[0]);
+  etcSubblockPalette(base[1], tables[1], palette[1]);
+
+  for (int i = 0; i < 16; i++) {
+    int bit = (i % 4) * 4 + i / 4;
+    int index = ((bits >> (16 + bit)) & 1) << 1 | ((bits >> bit) & 1);
+    int subblock = etcSubblock(i % 4, i / 4, flip);
+    for (int c = 0; c < 3; c++) block.rgba[i][c] = palette[subblock][index][c];
+    block.rgba[i][3] = 255;
+  }
+}
+
+#endif /* BLOCKCOMPRESSION_H */
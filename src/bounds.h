@@ -0,0 +1,193 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <cmath>
+#include <algorithm>
+#include <sys/types.h>
+#include <glm/glm.hpp>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * bounding volumes for meshes, models and props
+ *
+ *   positionBounds  aabb, a simd min/max over the positions
+ *   ritterSphere    a sphere around the positions, Ritter's two passes then shrunk to the
+ *                   furthest point from its center. within a few percent of the smallest
+ *                   one, which is all culling needs
+ *
+ * positions are read as 3 floats every `stride` floats (8 for a Vertex), so mesh.h can
+ * call these before it has finished declaring Vertex
+ */
+
+struct BoundingBox {
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+
+  glm::vec3 center() const { return (min + max) * 0.5f; }
+  glm::vec3 extent() const { return (max - min) * 0.5f; }
+};
+
+struct BoundingSphere {
+  glm::vec3 center = glm::vec3(0.0f);
+  float     radius = 0.0f;
+
+  bool operator==(const BoundingSphere& other) const { return center == other.center && radius == other.radius; }
+  bool operator!=(const BoundingSphere& other) const { return !(*this == other); }
+};
+
+static inline glm::vec3 boundsPosition(const float* positions, uint stride, uint i) {
+  const float* p = positions + (size_t)i * stride;
+  return glm::vec3(p[0], p[1], p[2]);
+}
+
+void positionBoundsScalar(const float* positions, uint count, uint stride, glm::vec3& min, glm::vec3& max) {
+  if (count == 0) {
+    min = max = glm::vec3(0.0f);
+    return;
+  }
+  min = max = boundsPosition(positions, stride, 0);
+  for (uint i = 1; i < count; i++) {
+    glm::vec3 p = boundsPosition(positions, stride, i);
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+}
+
+void positionBounds(const float* positions, uint count, uint stride, glm::vec3& min, glm::vec3& max) {
+  // the 4 float loads read one past the position, so only with room for it in every vertex
+  if (count < 2 || stride < 4) {
+    positionBoundsScalar(positions, count, stride, min, max);
+    return;
+  }
+
+  uint i = 0;
+#if defined(__SSE2__)
+  // two pairs of accumulators so consecutive vertices don't wait on each other.
+  // the fourth lane is whatever follows the position and is thrown away
+  __m128 lo0 = _mm_loadu_ps(positions), hi0 = lo0, lo1 = lo0, hi1 = lo0;
+  for (; i + 2 <= count; i += 2) {
+    __m128 a = _mm_loadu_ps(positions + (size_t)i * stride);
+    __m128 b = _mm_loadu_ps(positions + (size_t)(i + 1) * stride);
+    lo0 = _mm_min_ps(lo0, a); hi0 = _mm_max_ps(hi0, a);
+    lo1 = _mm_min_ps(lo1, b); hi1 = _mm_max_ps(hi1, b);
+  }
+  float lo[4], hi[4];
+  _mm_storeu_ps(lo, _mm_min_ps(lo0, lo1));
+  _mm_storeu_ps(hi, _mm_max_ps(hi0, hi1));
+#elif defined(__ARM_NEON)
+  float32x4_t lo0 = vld1q_f32(positions), hi0 = lo0, lo1 = lo0, hi1 = lo0;
+  for (; i + 2 <= count; i += 2) {
+    float32x4_t a = vld1q_f32(positions + (size_t)i * stride);
+    float32x4_t b = vld1q_f32(positions + (size_t)(i + 1) * stride);
+    lo0 = vminq_f32(lo0, a); hi0 = vmaxq_f32(hi0, a);
+    lo1 = vminq_f32(lo1, b); hi1 = vmaxq_f32(hi1, b);
+  }
+  float lo[4], hi[4];
+  vst1q_f32(lo, vminq_f32(lo0, lo1));
+  vst1q_f32(hi, vmaxq_f32(hi0, hi1));
+#else
+  positionBoundsScalar(positions, count, stride, min, max);
+  return;
+#endif
+  min = glm::vec3(lo[0], lo[1], lo[2]);
+  max = glm::vec3(hi[0], hi[1], hi[2]);
+  for (; i < count; i++) {
+    glm::vec3 p = boundsPosition(positions, stride, i);
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+}
+
+static uint furthestPosition(const float* positions, uint count, uint stride, glm::vec3 from) {
+  uint furthest = 0;
+  float furthestDistance = -1.0f;
+  for (uint i = 0; i < count; i++) {
+    glm::vec3 offset = boundsPosition(positions, stride, i) - from;
+    float distance = glm::dot(offset, offset);
+    if (distance > furthestDistance) {
+      furthest = i;
+      furthestDistance = distance;
+    }
+  }
+  return furthest;
+}
+
+// the radius that just contains every position around center
+static float enclosingRadius(const float* positions, uint count, uint stride, glm::vec3 center) {
+  float radius = 0.0f;
+  for (uint i = 0; i < count; i++) {
+    glm::vec3 offset = boundsPosition(positions, stride, i) - center;
+    radius = std::max(radius, glm::dot(offset, offset));
+  }
+  return std::sqrt(radius);
+}
+
+BoundingSphere ritterSphere(const float* positions, uint count, uint stride) {
+  BoundingSphere sphere;
+  if (count == 0) return sphere;
+
+  // the two positions furthest apart along some direction make the first guess
+  glm::vec3 a = boundsPosition(positions, stride, furthestPosition(positions, count, stride, boundsPosition(positions, stride, 0)));
+  glm::vec3 b = boundsPosition(positions, stride, furthestPosition(positions, count, stride, a));
+  sphere.center = (a + b) * 0.5f;
+  sphere.radius = glm::length(b - a) * 0.5f;
+
+  // then grow it just enough to take in anything left outside, moving the center toward it
+  for (uint i = 0; i < count; i++) {
+    glm::vec3 offset = boundsPosition(positions, stride, i) - sphere.center;
+    float distance = glm::length(offset);
+    if (distance <= sphere.radius) continue;
+
+    float radius = (sphere.radius + distance) * 0.5f;
+    sphere.center += offset * ((radius - sphere.radius) / distance);
+    sphere.radius = radius;
+  }
+
+  // growing leaves it a little loose, and float rounding may leave a point just outside
+  sphere.radius = enclosingRadius(positions, count, stride, sphere.center);
+  return sphere;
+}
+
+// the smallest sphere around both
+BoundingSphere mergeSpheres(const BoundingSphere& a, const BoundingSphere& b) {
+  glm::vec3 offset = b.center - a.center;
+  float distance = glm::length(offset);
+  if (distance + b.radius <= a.radius) return a;
+  if (distance + a.radius <= b.radius) return b;
+
+  BoundingSphere merged;
+  merged.radius = (distance + a.radius + b.radius) * 0.5f;
+  merged.center = a.center + offset * ((merged.radius - a.radius) / distance);
+  return merged;
+}
+
+// the sphere through the corners of the box, sometimes tighter than one built from parts
+BoundingSphere boxSphere(glm::vec3 min, glm::vec3 max) {
+  BoundingSphere sphere;
+  sphere.center = (min + max) * 0.5f;
+  sphere.radius = glm::length(max - sphere.center);
+  return sphere;
+}
+
+// the box around the transformed box (Arvo): each axis of the result takes the absolute
+// contribution of every input axis
+BoundingBox transformBox(glm::vec3 min, glm::vec3 max, const glm::mat4& transform) {
+  glm::vec3 center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+  glm::vec3 extent = (max - min) * 0.5f;
+
+  glm::vec3 worldExtent(0.0f);
+  for (int axis = 0; axis < 3; axis++)
+    worldExtent += glm::abs(glm::vec3(transform[axis])) * extent[axis];
+
+  BoundingBox box;
+  box.min = center - worldExtent;
+  box.max = center + worldExtent;
+  return box;
+}
+
+#endif /* BOUNDS_H */
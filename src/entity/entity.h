@@ -6,6 +6,7 @@
 class Entity {
   public:
     Entity(glm::vec3 position, glm::vec3 direction);
+    virtual ~Entity() {}
 
     void setPosition(glm::vec3 position);
     void setPosition(float x, float y, float z);
@@ -20,6 +21,10 @@ class Entity {
 
   protected:
     glm::vec3 _position, _direction, _rotation;
+
+    // after the transform changes, for subclasses that keep something worked out from it
+    virtual void moved(glm::vec3 /*offset*/) {}
+    virtual void rotated() {}
 };
 
 Entity::Entity(glm::vec3 position, glm::vec3 direction)
@@ -27,17 +32,20 @@ Entity::Entity(glm::vec3 position, glm::vec3 direction)
 }
 
 void Entity::setPosition(glm::vec3 position) {
+  glm::vec3 offset = position - _position;
   _position = position;
+  moved(offset);
 }
 
 void Entity::setPosition(float x, float y, float z) {
-  _position.x = x; 
-  _position.y = y; 
-  _position.z = z; 
+  setPosition(glm::vec3(x, y, z));
 }
 
 void Entity::setDirection(glm::vec3 direction) {
-  _direction = glm::normalize(direction);
+  direction = glm::normalize(direction);
+  if (direction == _direction) return;
+  _direction = direction;
+  rotated();
 }
 
 glm::vec3 Entity::getPosition() {
@@ -50,14 +58,17 @@ glm::vec3 Entity::getDirection() {
 
 void Entity::setRotationX(float degrees) {
   _rotation.x = degrees;
+  rotated();
 }
 
 void Entity::setRotationY(float degrees) {
   _rotation.y = degrees;
+  rotated();
 }
 
 void Entity::setRotationZ(float degrees) {
   _rotation.z = degrees;
+  rotated();
 }
 
 glm::vec3 Entity::getRotation() {
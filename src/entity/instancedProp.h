@@ -0,0 +1,188 @@
+#ifndef INSTANCEDPROP_H
+#define INSTANCEDPROP_H
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "shader.h"
+#include "model.h"
+#include "frustum.h"
+#include "view.h"
+#include "bounds.h"
+#include "glState.h"
+#include "renderQueue.h"
+#include "prop.h"
+
+/*
+ * one model drawn many times (an asteroid field) with glDrawElementsInstanced, the
+ * per-instance model matrix and tint coming from a buffer, see instanced.vert
+ *
+ * every frame the instances are culled against the frustum and given a lod by their size
+ * on screen, the same LOD_ERROR_PIXELS rule Prop uses, without hysteresis. the visible ones
+ * are written into the instance buffer grouped by lod, one range per lod in use, and each
+ * mesh draws all the ranges in one multiDraw (see GeometryArena), a single gl call where
+ * base instance is supported. the buffer is orphaned before the write, so it never waits
+ * on last frame's draws
+ *
+ * instances are meant to be rigid with a uniform scale, instanced.vert doesn't build a
+ * normal matrix per vertex
+ */
+
+class InstancedProp : public Renderable {
+  public:
+    // the model may still be streaming in, nothing is drawn until it's resident
+    InstancedProp(std::shared_ptr<Model> model);
+    ~InstancedProp();
+
+    InstancedProp(const InstancedProp&) = delete;
+    InstancedProp& operator=(const InstancedProp&) = delete;
+
+    // returns the instance's index
+    uint add(const glm::mat4& transform, glm::vec4 tint = glm::vec4(1.0f));
+    void set(uint index, const glm::mat4& transform, glm::vec4 tint = glm::vec4(1.0f));
+    void reserve(size_t count);
+    size_t size() const { return _instances.size(); }
+
+    void draw(Shader& shader, const View& view);
+
+    // queued as opaque, drawn by the queue's flush
+    void submit(RenderQueue& queue, Shader& shader, const View& view);
+    void render(Shader& shader, const View& view) override;
+
+    // instances that passed the frustum in the last draw
+    size_t visible() const { return _visible.size(); }
+
+  private:
+    std::shared_ptr<Model> _model;
+
+    std::vector<InstanceData> _instances;
+    // world space, rebuilt from the transform and the model's sphere when either changes
+    std::vector<BoundingSphere> _spheres;
+    // the model's sphere _spheres were built from
+    BoundingSphere _localSphere;
+
+    // this frame's visible instances grouped by lod, and where each lod's group starts
+    std::vector<InstanceData> _visible;
+    std::vector<uint8_t>      _lods;
+    std::vector<size_t>       _lodStarts;
+    std::vector<size_t>       _lodNext;
+    std::vector<InstanceRange> _ranges;
+
+    uint   _buffer;
+    size_t _capacity;
+
+    BoundingSphere instanceSphere(const glm::mat4& transform) const;
+    void updateSpheres();
+    uint selectLod(float pixelsPerUnit) const;
+    void upload();
+};
+
+InstancedProp::InstancedProp(std::shared_ptr<Model> model)
+  : _model(model), _buffer(0), _capacity(0) {
+  glGenBuffers(1, &_buffer);
+}
+
+InstancedProp::~InstancedProp() {
+  if (_buffer) GLState::shared().deleteBuffer(_buffer);
+}
+
+uint InstancedProp::add(const glm::mat4& transform, glm::vec4 tint) {
+  _instances.push_back({ transform, tint });
+  _spheres.push_back(instanceSphere(transform));
+  return _instances.size() - 1;
+}
+
+void InstancedProp::set(uint index, const glm::mat4& transform, glm::vec4 tint) {
+  _instances[index] = { transform, tint };
+  _spheres[index] = instanceSphere(transform);
+}
+
+void InstancedProp::reserve(size_t count) {
+  _instances.reserve(count);
+  _spheres.reserve(count);
+}
+
+// the largest axis scale covers a non uniform one too, just loosely
+BoundingSphere InstancedProp::instanceSphere(const glm::mat4& transform) const {
+  float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+  BoundingSphere sphere;
+  sphere.center = glm::vec3(transform * glm::vec4(_localSphere.center, 1.0f));
+  sphere.radius = _localSphere.radius * scale;
+  return sphere;
+}
+
+// a streamed model's bounds arrive after the instances were added
+void InstancedProp::updateSpheres() {
+  if (_model->boundingSphere == _localSphere) return;
+  _localSphere = _model->boundingSphere;
+  for (size_t i = 0; i < _instances.size(); i++) _spheres[i] = instanceSphere(_instances[i].transform);
+}
+
+uint InstancedProp::selectLod(float pixelsPerUnit) const {
+  uint count = _model->lodCount();
+  uint lod = 0;
+  while (lod + 1 < count && _model->lodError(lod + 1) * pixelsPerUnit < LOD_ERROR_PIXELS) lod++;
+  return lod;
+}
+
+void InstancedProp::upload() {
+  size_t bytes = _visible.size() * sizeof(InstanceData);
+  GLState::shared().bindBuffer(GL_ARRAY_BUFFER, _buffer);
+  if (_visible.size() > _capacity) _capacity = std::max(_visible.size(), _capacity * 2);
+  // orphaned, the driver hands back fresh memory if the old is still being drawn from
+  glBufferData(GL_ARRAY_BUFFER, _capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, _visible.data());
+}
+
+void InstancedProp::draw(Shader& shader, const View& view) {
+  if (!_model->isResident() || _instances.empty()) return;
+  updateSpheres();
+
+  Frustum frustum(view.viewProjection());
+  uint lodCount = std::min(_model->lodCount(), 255u);
+
+  // cull and pick lods, counting each lod's instances
+  _lods.resize(_instances.size());
+  _lodStarts.assign(lodCount + 1, 0);
+  for (size_t i = 0; i < _instances.size(); i++) {
+    const BoundingSphere& sphere = _spheres[i];
+    if (!frustum.intersectsSphere(sphere.center, sphere.radius)) {
+      _lods[i] = UINT8_MAX;
+      continue;
+    }
+    float distance = glm::length(sphere.center - view.position) - sphere.radius;
+    uint lod = std::min(selectLod(view.pixelsPerUnit(std::max(distance, 0.01f))), lodCount - 1);
+    _lods[i] = lod;
+    _lodStarts[lod + 1]++;
+  }
+  for (uint lod = 0; lod < lodCount; lod++) _lodStarts[lod + 1] += _lodStarts[lod];
+
+  // then place them, each lod's instances together
+  _visible.resize(_lodStarts[lodCount]);
+  _lodNext.assign(_lodStarts.begin(), _lodStarts.end() - 1);
+  for (size_t i = 0; i < _instances.size(); i++)
+    if (_lods[i] != UINT8_MAX) _visible[_lodNext[_lods[i]]++] = _instances[i];
+
+  if (_visible.empty()) return;
+  upload();
+
+  _ranges.clear();
+  for (uint lod = 0; lod < lodCount; lod++) {
+    uint count = _lodStarts[lod + 1] - _lodStarts[lod];
+    if (count > 0) _ranges.push_back({ _lodStarts[lod], count, lod });
+  }
+  _model->drawInstanced(shader, _buffer, _ranges);
+}
+
+void InstancedProp::submit(RenderQueue& queue, Shader& shader, const View& /*view*/) {
+  if (_instances.empty()) return;
+  // spread all over, it goes in at the front of its state group
+  queue.submit(RENDER_PASS_OPAQUE, shader, _model->firstTexture(), _model->vertexArray(), 0.0f, *this);
+}
+
+void InstancedProp::render(Shader& shader, const View& view) {
+  draw(shader, view);
+}
+
+#endif /* INSTANCEDPROP_H */
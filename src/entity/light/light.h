@@ -1,23 +1,46 @@
 #ifndef LIGHT_H
 #define LIGHT_H
 
-#include "../../shader.h"
+#include "../../uniformBuffer.h"
 #include "../entity.h"
 
 class Light : public Entity {
   public:
     Light(glm::vec3 position, glm::vec3 direction, glm::vec3 ambient = glm::vec3(1.0f), glm::vec3 diffuse = glm::vec3(1.0f), glm::vec3 specular = glm::vec3(1.0f));
 
-    virtual void addToShader(Shader& shader, uint index = 0) = 0;
+    // changed since it was last packed. the subclasses' pack() skips a clean light
+    // unless forced, e.g. when it's been given a different slot
+    bool isDirty() const { return _dirty; }
+    void setDirty() { _dirty = true; }
 
   protected:
     glm::vec3 _ambient;
     glm::vec3 _diffuse;
     glm::vec3 _specular;
+    bool      _dirty = true;
+
+    virtual void moved(glm::vec3 offset);
+    virtual void rotated();
+    // true if the light has to be written out, and marks it clean
+    bool repack(bool force);
 };
 
 Light::Light(glm::vec3 position, glm::vec3 direction, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular)
   : Entity(position, direction), _ambient(ambient), _diffuse(diffuse), _specular(specular) {
 }
 
+void Light::moved(glm::vec3 offset) {
+  if (offset != glm::vec3(0.0f)) _dirty = true;
+}
+
+void Light::rotated() {
+  _dirty = true;
+}
+
+bool Light::repack(bool force) {
+  if (!_dirty && !force) return false;
+  _dirty = false;
+  return true;
+}
+
 #endif /* LIGHT_H */
@@ -7,7 +7,8 @@ class PointLight : public Light {
   public:
     PointLight(glm::vec3 position, glm::vec3 ambient = glm::vec3(1.0f), glm::vec3 diffuse = glm::vec3(1.0f), glm::vec3 specular = glm::vec3(1.0f), float constant = 1.0f, float linear = 0.05f, float quadratic = 0.032f);
 
-    virtual void addToShader(Shader& shader, uint index = 0);
+    // into its slot in LightData, false if it was clean and left alone
+    bool pack(PointLightData& out, bool force = false);
 
   private:
     float _constant, _linear, _quadratic;
@@ -17,16 +18,16 @@ PointLight::PointLight(glm::vec3 position, glm::vec3 ambient, glm::vec3 diffuse,
   : Light(position, glm::vec3(0), ambient, diffuse, specular), _constant(constant), _linear(linear), _quadratic(quadratic) {
 }
 
-void PointLight::addToShader(Shader& shader, uint index) {
-  std::string strindex = std::to_string(index);
-  shader.use();
-  shader.setVec3("pointLights[" + strindex + "].position",   _position);
-  shader.setVec3("pointLights[" + strindex + "].ambient",    _ambient);
-  shader.setVec3("pointLights[" + strindex + "].diffuse",    _diffuse);
-  shader.setVec3("pointLights[" + strindex + "].specular",   _specular);
-  shader.setFloat("pointLights[" + strindex + "].constant",  _constant);
-  shader.setFloat("pointLights[" + strindex + "].linear",    _linear);
-  shader.setFloat("pointLights[" + strindex + "].quadratic", _quadratic);
+bool PointLight::pack(PointLightData& out, bool force) {
+  if (!repack(force)) return false;
+  out.position  = _position;
+  out.ambient   = _ambient;
+  out.diffuse   = _diffuse;
+  out.specular  = _specular;
+  out.constant  = _constant;
+  out.linear    = _linear;
+  out.quadratic = _quadratic;
+  return true;
 }
 
 #endif /* POINTLIGHT_H */
@@ -1,33 +1,241 @@
 #ifndef PROP_H
 #define PROP_H
 
+#include <memory>
 #include "shader.h"
 #include "entity.h"
+#include "model.h"
+#include "assetManager.h"
+#include "frustum.h"
+#include "view.h"
+#include "bounds.h"
+#include "renderQueue.h"
 
-class Prop : public Entity {
+// a lod is good enough while its error covers less than this many pixels on screen
+#define LOD_ERROR_PIXELS 1.0f
+// how far past the threshold the error has to get before the lod changes, so props
+// sitting right on it don't flicker between levels
+#define LOD_HYSTERESIS   0.25f
+
+class Prop : public Entity, public Renderable {
   public:
+    // shares the model with every other prop using the same file, see AssetManager
     Prop(glm::vec3 position, glm::vec3 direction, std::string modelFilepath);
+    // shares a model that may still be streaming in, see ModelStreamer
+    Prop(glm::vec3 position, glm::vec3 direction, std::shared_ptr<Model> model);
+
+    void draw(Shader& shader);
+    // same, but skips whatever of the model is off screen or facing away from the camera
+    // and draws the coarsest lod whose error stays under LOD_ERROR_PIXELS. texture detail
+    // is requested for the size the prop is on screen
+    void draw(Shader& shader, const View& view);
+
+    // queued as opaque, drawn by the queue's flush with draw(shader, view)
+    void submit(RenderQueue& queue, Shader& shader, const View& view);
+    void render(Shader& shader, const View& view) override;
+
+    // the model's bounds in world space. moving the prop shifts them, turning it or a
+    // streamed model's bounds arriving has them rebuilt the next time they're asked for
+    BoundingBox worldBox();
+    BoundingSphere worldSphere();
 
-    void draw(Shader shader);
+  protected:
+    void moved(glm::vec3 offset) override;
+    void rotated() override;
 
   private:
-    Model _model;
+    std::shared_ptr<Model> _model;
+    uint _lod;
+
+    glm::mat4 _modelMatrix;
+    // the rotation changed since _modelMatrix and the world bounds were built
+    bool _rotated;
+    // the model's bounds the world ones were built from
+    glm::vec3      _localMin, _localMax;
+    BoundingSphere _localSphere;
+    BoundingBox    _worldBox;
+    BoundingSphere _worldSphere;
+
+    void updateTransform();
+    glm::mat4 modelMatrix();
+    bool drawPlaceholder(Shader& shader, glm::mat4 model);
+    float pixelsPerUnit(const View& view);
+    uint selectLod(const View& view);
+
+    static Mesh& placeholder();
 };
 
 Prop::Prop(glm::vec3 position, glm::vec3 direction, std::string modelFilepath)
-  : Entity(position, direction), _model(Model(modelFilepath)) {
+  : Prop(position, direction, AssetManager::shared().model(modelFilepath)) {
+}
+
+Prop::Prop(glm::vec3 position, glm::vec3 direction, std::shared_ptr<Model> model)
+  : Entity(position, direction), _model(model), _lod(0),
+    _modelMatrix(1.0f), _rotated(true), _localMin(0.0f), _localMax(0.0f) {
+}
+
+// unit cube stood in for models that aren't resident yet, scaled to their bounds once those are known
+Mesh& Prop::placeholder() {
+  // never freed, at exit that would come after the context is gone
+  static Mesh& cube = *[]() {
+    std::vector<Vertex> vertices;
+    std::vector<uint> indices;
+
+    for (int axis = 0; axis < 3; axis++) {
+      for (int side = -1; side <= 1; side += 2) {
+        glm::vec3 normal(0.0f);
+        normal[axis] = side;
+        glm::vec3 u(0.0f), v(0.0f);
+        u[(axis + 1) % 3] = 0.5f;
+        v[(axis + 2) % 3] = 0.5f * side;
+
+        uint base = vertices.size();
+        glm::vec2 corners[] = { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) };
+        for (glm::vec2 corner : corners) {
+          Vertex vertex;
+          vertex.position  = normal * 0.5f + u * corner.x + v * corner.y;
+          vertex.normal    = normal;
+          vertex.texCoords = (corner + glm::vec2(1.0f, 1.0f)) * 0.5f;
+          vertices.push_back(vertex);
+        }
+        indices.insert(indices.end(), { base, base + 1, base + 2, base + 2, base + 3, base });
+      }
+    }
+
+    return new Mesh(std::move(vertices), std::move(indices), std::vector<MeshTexture>());
+  }();
+  return cube;
+}
+
+void Prop::moved(glm::vec3 offset) {
+  // no need to rebuild anything for a translation
+  _modelMatrix[3] += glm::vec4(offset, 0.0f);
+  _worldBox.min += offset;
+  _worldBox.max += offset;
+  _worldSphere.center += offset;
 }
 
-void Prop::draw(Shader shader) {
+void Prop::rotated() {
+  _rotated = true;
+}
+
+// brings the matrix and world bounds up to date with the rotation and the model's bounds
+void Prop::updateTransform() {
+  bool boundsChanged = _model->boundsMin != _localMin || _model->boundsMax != _localMax || _model->boundingSphere != _localSphere;
+  if (!_rotated && !boundsChanged) return;
+
+  if (_rotated) {
+    glm::mat4 model = glm::mat4(1.0f);
+    //model = glm::scale(model, _scale);
+    model = glm::translate(model, _position);
+    model = glm::rotate(model, glm::radians(360.0f * _rotation.x), glm::vec3(1, 0, 0));
+    model = glm::rotate(model, glm::radians(360.0f * _rotation.y), glm::vec3(0, 1, 0));
+    model = glm::rotate(model, glm::radians(360.0f * _rotation.z), glm::vec3(0, 0, 1));
+    _modelMatrix = model;
+    _rotated = false;
+  }
+
+  _localMin    = _model->boundsMin;
+  _localMax    = _model->boundsMax;
+  _localSphere = _model->boundingSphere;
+
+  // rotation and translation only, so the radius carries over as it is
+  _worldBox = transformBox(_localMin, _localMax, _modelMatrix);
+  _worldSphere.center = glm::vec3(_modelMatrix * glm::vec4(_localSphere.center, 1.0f));
+  _worldSphere.radius = _localSphere.radius;
+}
+
+glm::mat4 Prop::modelMatrix() {
+  updateTransform();
+  return _modelMatrix;
+}
+
+BoundingBox Prop::worldBox() {
+  updateTransform();
+  return _worldBox;
+}
+
+BoundingSphere Prop::worldSphere() {
+  updateTransform();
+  return _worldSphere;
+}
+
+static const Uniform& modelUniform() {
+  static const Uniform model("model");
+  return model;
+}
+
+// true if the model isn't resident yet and the placeholder was drawn instead
+bool Prop::drawPlaceholder(Shader& shader, glm::mat4 model) {
+  if (!_model->isResident()) {
+    glm::vec3 extent = _model->boundsMax - _model->boundsMin;
+    if (extent == glm::vec3(0.0f)) extent = glm::vec3(1.0f);
+    model = glm::translate(model, (_model->boundsMin + _model->boundsMax) * 0.5f);
+    model = glm::scale(model, extent);
+
+    shader.setMat4(modelUniform(), model);
+    placeholder().draw(shader);
+    return true;
+  }
+  return false;
+}
+
+void Prop::draw(Shader& shader) {
+  shader.use();
+  glm::mat4 model = modelMatrix();
+  if (drawPlaceholder(shader, model)) return;
+
+  // nothing to say how big it is on screen, so ask for everything
+  _model->requestTextureDetail(INFINITY);
+  shader.setMat4(modelUniform(), model);
+  _model->draw(shader);
+}
+
+void Prop::draw(Shader& shader, const View& view) {
   shader.use();
-  glm::mat4 model = glm::mat4(1.0f);
-  //model = glm::scale(model, _scale);
-  model = glm::translate(model, _position);
-  model = glm::rotate(model, glm::radians(360.0f * _rotation.x), glm::vec3(1, 0, 0));
-  model = glm::rotate(model, glm::radians(360.0f * _rotation.y), glm::vec3(0, 1, 0));
-  model = glm::rotate(model, glm::radians(360.0f * _rotation.z), glm::vec3(0, 0, 1));
-  shader.setMat4("model",      model);
-  _model.draw(shader);
+  glm::mat4 model = modelMatrix();
+  if (drawPlaceholder(shader, model)) return;
+
+  // culling happens in model space, planes straight out of the full mvp and the camera brought back through the model matrix
+  Frustum frustum(view.viewProjection() * model);
+  glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(view.position, 1.0f));
+
+  // props that are off screen ask for nothing and their textures' detail is let go of
+  const BoundingSphere& sphere = _model->boundingSphere;
+  if (frustum.intersectsSphere(sphere.center, sphere.radius))
+    _model->requestTextureDetail(2.0f * sphere.radius * pixelsPerUnit(view));
+
+  shader.setMat4(modelUniform(), model);
+  _model->draw(shader, frustum, camera, selectLod(view));
+}
+
+void Prop::submit(RenderQueue& queue, Shader& shader, const View& view) {
+  BoundingSphere sphere = worldSphere();
+  float depth = std::max(glm::length(sphere.center - view.position) - sphere.radius, 0.0f);
+  queue.submit(RENDER_PASS_OPAQUE, shader, _model->firstTexture(), _model->vertexArray(), depth, *this);
+}
+
+void Prop::render(Shader& shader, const View& view) {
+  draw(shader, view);
+}
+
+// measured from the nearest point of the bounding sphere, so a big prop close up stays detailed
+float Prop::pixelsPerUnit(const View& view) {
+  BoundingSphere sphere = worldSphere();
+  float distance = glm::length(sphere.center - view.position) - sphere.radius;
+  return view.pixelsPerUnit(std::max(distance, 0.01f));
+}
+
+uint Prop::selectLod(const View& view) {
+  uint count = _model->lodCount();
+  if (_lod >= count) _lod = count - 1;
+  if (count == 1) return _lod;
+
+  float pixels = pixelsPerUnit(view);
+
+  while (_lod + 1 < count && _model->lodError(_lod + 1) * pixels < LOD_ERROR_PIXELS * (1.0f - LOD_HYSTERESIS)) _lod++;
+  while (_lod > 0 && _model->lodError(_lod) * pixels > LOD_ERROR_PIXELS * (1.0f + LOD_HYSTERESIS)) _lod--;
+  return _lod;
 }
 
 #endif /* PROP_H */
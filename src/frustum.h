@@ -0,0 +1,40 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// the six clip planes of a projection, in whatever space the matrix maps from
+// (pass projection * view * model to get them in model space)
+struct Frustum {
+  glm::vec4 planes[6];
+
+  Frustum(const glm::mat4& matrix);
+
+  bool intersectsSphere(glm::vec3 center, float radius) const;
+};
+
+Frustum::Frustum(const glm::mat4& m) {
+  glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+  glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+  glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+  glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+  planes[0] = row3 + row0; // left
+  planes[1] = row3 - row0; // right
+  planes[2] = row3 + row1; // bottom
+  planes[3] = row3 - row1; // top
+  planes[4] = row3 + row2; // near
+  planes[5] = row3 - row2; // far
+
+  for (glm::vec4& plane : planes)
+    plane = plane / glm::length(glm::vec3(plane));
+}
+
+bool Frustum::intersectsSphere(glm::vec3 center, float radius) const {
+  for (const glm::vec4& plane : planes) {
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+  }
+  return true;
+}
+
+#endif /* FRUSTUM_H */
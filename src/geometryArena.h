@@ -0,0 +1,347 @@
+#ifndef GEOMETRYARENA_H
+#define GEOMETRYARENA_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <sys/types.h>
+#include "glad/glad.h"
+#include "glExtensions.h"
+#include "glState.h"
+#include "vertex.h"
+
+/*
+ * one vertex buffer, index buffer and vertex array per vertex layout, every mesh of that
+ * layout takes a piece of them. going from one mesh to the next never switches vertex
+ * arrays, and draws of one mesh that only differ in the range they cover (visible
+ * meshlet runs, an InstancedProp's lod ranges) can go out as one call
+ *
+ * that's as far as the merging goes, every mesh still makes its own multiDraw. its
+ * textures, quantisation and a prop's model matrix are uniforms set before it, and
+ * putting several meshes in one call would need those per draw
+ *
+ * meshes draw with the base vertex draws (core since 3.2), so their indices stay relative
+ * to their own first vertex and keep fitting in 16 bits. both index sizes share the index
+ * buffer, every piece of it starts 4 byte aligned
+ *
+ * multiDraw() takes commands in the layout glMultiDrawElementsIndirect reads. on 4.3 they
+ * go to the gpu in a buffer and out in one call, each instanced command reading its
+ * instances from its own base instance. before that, plain commands go out in one
+ * glMultiDrawElementsBaseVertex and instanced ones one at a time, the instance attributes
+ * pointed further into their buffer for each. the shaders are 3.30 so there's no
+ * gl_DrawID, anything that changes per command has to come in as an instance attribute
+ *
+ * the buffers double when something doesn't fit, copied over on the gpu. the arenas are
+ * never freed, the context is gone by the time statics would be
+ *
+ * gl thread only
+ */
+
+#define GEOMETRY_ARENA_MIN_VERTICES    65536
+#define GEOMETRY_ARENA_MIN_INDEX_BYTES (256 * 1024)
+#define GEOMETRY_ARENA_INDEX_ALIGNMENT 4
+// RangeAllocator::allocate when nothing free is big enough
+#define GEOMETRY_ARENA_FULL            SIZE_MAX
+
+// the command glMultiDrawElementsIndirect reads, firstIndex in indices of the draw's type
+// from the start of the index buffer
+struct DrawElementsIndirectCommand {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int  baseVertex;
+  uint baseInstance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand has to be tightly packed");
+
+// first fit over [0, capacity), freed ranges merge back with their neighbours
+class RangeAllocator {
+  public:
+    // GEOMETRY_ARENA_FULL if there's no room, grow() and ask again
+    size_t allocate(size_t size, size_t alignment = 1);
+    void free(size_t offset, size_t size);
+    // the space from capacity() up to newCapacity becomes free
+    void grow(size_t newCapacity);
+
+    size_t capacity() const { return _capacity; }
+    size_t used() const { return _used; }
+
+  private:
+    struct Range {
+      size_t offset;
+      size_t size;
+    };
+
+    // sorted by offset, never two touching
+    std::vector<Range> _free;
+    size_t _capacity = 0;
+    size_t _used     = 0;
+
+    void release(size_t offset, size_t size);
+};
+
+size_t RangeAllocator::allocate(size_t size, size_t alignment) {
+  if (size == 0) return 0;
+
+  for (size_t i = 0; i < _free.size(); i++) {
+    Range range = _free[i];
+    size_t start = (range.offset + alignment - 1) / alignment * alignment;
+    size_t end   = range.offset + range.size;
+    if (start + size > end) continue;
+
+    // whatever's left either side stays free
+    _free.erase(_free.begin() + i);
+    if (end > start + size)    _free.insert(_free.begin() + i, { start + size, end - start - size });
+    if (start > range.offset)  _free.insert(_free.begin() + i, { range.offset, start - range.offset });
+    _used += size;
+    return start;
+  }
+  return GEOMETRY_ARENA_FULL;
+}
+
+void RangeAllocator::free(size_t offset, size_t size) {
+  if (size == 0) return;
+  release(offset, size);
+  _used -= size;
+}
+
+void RangeAllocator::grow(size_t newCapacity) {
+  if (newCapacity <= _capacity) return;
+  release(_capacity, newCapacity - _capacity);
+  _capacity = newCapacity;
+}
+
+void RangeAllocator::release(size_t offset, size_t size) {
+  auto next = std::lower_bound(_free.begin(), _free.end(), offset,
+      [](const Range& range, size_t offset) { return range.offset < offset; });
+  size_t i = next - _free.begin();
+  _free.insert(next, { offset, size });
+
+  if (i + 1 < _free.size() && _free[i].offset + _free[i].size == _free[i + 1].offset) {
+    _free[i].size += _free[i + 1].size;
+    _free.erase(_free.begin() + i + 1);
+  }
+  if (i > 0 && _free[i - 1].offset + _free[i - 1].size == _free[i].offset) {
+    _free[i - 1].size += _free[i].size;
+    _free.erase(_free.begin() + i);
+  }
+}
+
+// a mesh's piece of an arena
+struct GeometryAllocation {
+  // the base vertex of its draws
+  uint   firstVertex = 0;
+  uint   vertexCount = 0;
+  // in bytes, GEOMETRY_ARENA_INDEX_ALIGNMENT aligned
+  size_t indexOffset = 0;
+  size_t indexBytes  = 0;
+};
+
+class GeometryArena {
+  public:
+    static GeometryArena& shared(VertexLayout layout);
+
+    GeometryArena(VertexLayout layout);
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // copies the vertices (in the arena's layout) and indices (either size) in, growing first if they don't fit
+    GeometryAllocation allocate(const void* vertices, uint vertexCount, const void* indices, size_t indexBytes);
+    void free(const GeometryAllocation& allocation);
+
+    uint vertexArray() const { return _vertexArray; }
+    uint stride() const { return _layout == VERTEX_LAYOUT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex); }
+
+    // binds the vertex array, all commands share the index type. with an instance buffer
+    // the commands are instanced, their InstanceData read from it from their base instance
+    void multiDraw(GLenum indexType, const DrawElementsIndirectCommand* commands, uint count, uint instanceBuffer = 0);
+    // emptied for the caller to build its commands in, kept so that doesn't allocate every
+    // draw. one user at a time, up to its multiDraw
+    std::vector<DrawElementsIndirectCommand>& commandScratch();
+
+  private:
+    VertexLayout _layout;
+    uint _vertexArray;
+    uint _vertexBuffer;
+    uint _indexBuffer;
+    uint _indirectBuffer;
+
+    // in vertices and in bytes
+    RangeAllocator _vertices;
+    RangeAllocator _indices;
+
+    // where the instance attributes point, without base instance they move for each command
+    uint   _instanceBuffer;
+    size_t _instanceOffset;
+
+    std::vector<DrawElementsIndirectCommand> _commands;
+    // glMultiDrawElementsBaseVertex's arrays, kept to save allocating them every draw
+    std::vector<GLsizei>     _counts;
+    std::vector<const void*> _offsets;
+    std::vector<GLint>       _baseVertices;
+
+    void setAttributes();
+    void pointInstances(uint buffer, size_t offset);
+    static uint resize(uint buffer, size_t bytes, size_t newBytes);
+};
+
+GeometryArena& GeometryArena::shared(VertexLayout layout) {
+  static GeometryArena* arenas[VERTEX_LAYOUT_COUNT] = {};
+  if (!arenas[layout]) arenas[layout] = new GeometryArena(layout);
+  return *arenas[layout];
+}
+
+GeometryArena::GeometryArena(VertexLayout layout)
+  : _layout(layout), _vertexArray(0), _vertexBuffer(0), _indexBuffer(0), _indirectBuffer(0),
+    _instanceBuffer(0), _instanceOffset(0) {
+  glGenVertexArrays(1, &_vertexArray);
+  glGenBuffers(1, &_indirectBuffer);
+}
+
+// a bigger buffer with the old one's contents, the old one deleted. nothing is left bound
+// to the element array binding, that belongs to whichever vertex array is bound
+uint GeometryArena::resize(uint buffer, size_t bytes, size_t newBytes) {
+  uint grown;
+  glGenBuffers(1, &grown);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+  glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+  if (buffer && bytes) {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+  }
+  if (buffer) GLState::shared().deleteBuffer(buffer);
+  return grown;
+}
+
+void GeometryArena::setAttributes() {
+  GLState::shared().bindVertexArray(_vertexArray);
+  GLState::shared().bindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+
+  if (_layout == VERTEX_LAYOUT_PACKED) {
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+    glEnableVertexAttribArray(2);
+  } else {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+    glEnableVertexAttribArray(2);
+  }
+
+  // so nothing bound later for something else lands in this one
+  GLState::shared().bindVertexArray(0);
+}
+
+GeometryAllocation GeometryArena::allocate(const void* vertices, uint vertexCount, const void* indices, size_t indexBytes) {
+  GeometryAllocation allocation;
+  allocation.vertexCount = vertexCount;
+  allocation.indexBytes  = indexBytes;
+
+  size_t firstVertex = _vertices.allocate(vertexCount);
+  size_t indexOffset = _indices.allocate(indexBytes, GEOMETRY_ARENA_INDEX_ALIGNMENT);
+  bool grown = false;
+
+  if (firstVertex == GEOMETRY_ARENA_FULL) {
+    size_t capacity = std::max({ (size_t)GEOMETRY_ARENA_MIN_VERTICES, _vertices.capacity() * 2, _vertices.capacity() + vertexCount });
+    _vertexBuffer = resize(_vertexBuffer, _vertices.capacity() * stride(), capacity * stride());
+    _vertices.grow(capacity);
+    firstVertex = _vertices.allocate(vertexCount);
+    grown = true;
+  }
+  if (indexOffset == GEOMETRY_ARENA_FULL) {
+    size_t capacity = std::max({ (size_t)GEOMETRY_ARENA_MIN_INDEX_BYTES, _indices.capacity() * 2, _indices.capacity() + indexBytes + GEOMETRY_ARENA_INDEX_ALIGNMENT });
+    _indexBuffer = resize(_indexBuffer, _indices.capacity(), capacity);
+    _indices.grow(capacity);
+    indexOffset = _indices.allocate(indexBytes, GEOMETRY_ARENA_INDEX_ALIGNMENT);
+    grown = true;
+  }
+  // new buffers, so the vertex array has to be told about them
+  if (grown) setAttributes();
+
+  allocation.firstVertex = firstVertex;
+  allocation.indexOffset = indexOffset;
+  if (vertexCount) GLState::shared().bufferSubData(GL_COPY_WRITE_BUFFER, _vertexBuffer, firstVertex * stride(), vertexCount * stride(), vertices);
+  if (indexBytes)  GLState::shared().bufferSubData(GL_COPY_WRITE_BUFFER, _indexBuffer, indexOffset, indexBytes, indices);
+  return allocation;
+}
+
+void GeometryArena::free(const GeometryAllocation& allocation) {
+  _vertices.free(allocation.firstVertex, allocation.vertexCount);
+  _indices.free(allocation.indexOffset, allocation.indexBytes);
+}
+
+std::vector<DrawElementsIndirectCommand>& GeometryArena::commandScratch() {
+  _commands.clear();
+  return _commands;
+}
+
+// the vertex array has to be bound
+void GeometryArena::pointInstances(uint buffer, size_t offset) {
+  if (buffer == _instanceBuffer && offset == _instanceOffset) return;
+
+  GLState::shared().bindBuffer(GL_ARRAY_BUFFER, buffer);
+  for (uint column = 0; column < 4; column++) {
+    uint attribute = INSTANCE_ATTRIBUTE_FIRST + column;
+    glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, transform) + column * sizeof(glm::vec4)));
+    glEnableVertexAttribArray(attribute);
+    glVertexAttribDivisor(attribute, 1);
+  }
+  uint tint = INSTANCE_ATTRIBUTE_FIRST + 4;
+  glVertexAttribPointer(tint, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, tint)));
+  glEnableVertexAttribArray(tint);
+  glVertexAttribDivisor(tint, 1);
+
+  _instanceBuffer = buffer;
+  _instanceOffset = offset;
+}
+
+void GeometryArena::multiDraw(GLenum indexType, const DrawElementsIndirectCommand* commands, uint count, uint instanceBuffer) {
+  if (count == 0) return;
+  GLState::shared().bindVertexArray(_vertexArray);
+
+  if (glCapabilities().multiDrawIndirect) {
+    if (instanceBuffer) pointInstances(instanceBuffer, 0);
+    // filled fresh every call, the driver hands back new memory if the last lot is still being read
+    GLState::shared().bindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, count * sizeof(DrawElementsIndirectCommand), commands, GL_STREAM_DRAW);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, nullptr, count, 0);
+    return;
+  }
+
+  uint indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint);
+
+  if (instanceBuffer) {
+    // no base instance before 4.2, so the attributes start where each command's instances do
+    for (uint i = 0; i < count; i++) {
+      const DrawElementsIndirectCommand& command = commands[i];
+      pointInstances(instanceBuffer, (size_t)command.baseInstance * sizeof(InstanceData));
+      glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, indexType, (void*)((uintptr_t)command.firstIndex * indexSize), command.instanceCount, command.baseVertex);
+    }
+    return;
+  }
+
+  _counts.clear();
+  _offsets.clear();
+  _baseVertices.clear();
+  for (uint i = 0; i < count; i++) {
+    _counts.push_back(commands[i].count);
+    _offsets.push_back((const void*)((uintptr_t)commands[i].firstIndex * indexSize));
+    _baseVertices.push_back(commands[i].baseVertex);
+  }
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, _counts.data(), indexType, _offsets.data(), count, _baseVertices.data());
+}
+
+#endif /* GEOMETRYARENA_H */
@@ -0,0 +1,138 @@
+#ifndef GLEXTENSIONS_H
+#define GLEXTENSIONS_H
+
+#include <cstring>
+#include "glad/glad.h"
+
+/*
+ * the bits of gl past what glad was generated for (3.3 core, no extensions)
+ *
+ * loadGLExtensions() runs once on the gl thread right after glad, and fills in
+ * glCapabilities() so code on any thread can check what the driver takes
+ */
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2          0x9274
+#endif
+
+// core since 4.2, or through ARB_texture_storage
+#ifndef glTexStorage2D
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+static PFNGLTEXSTORAGE2DPROC glad_glTexStorage2D = nullptr;
+#define glTexStorage2D glad_glTexStorage2D
+#endif
+
+// direct state access, core since 4.5 or through ARB_direct_state_access
+#ifndef glBindTextureUnit
+typedef void (APIENTRYP PFNGLBINDTEXTUREUNITPROC)(GLuint unit, GLuint texture);
+typedef void (APIENTRYP PFNGLCREATETEXTURESPROC)(GLenum target, GLsizei n, GLuint* textures);
+typedef void (APIENTRYP PFNGLTEXTURESTORAGE2DPROC)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLTEXTURESUBIMAGE2DPROC)(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels);
+typedef void (APIENTRYP PFNGLTEXTUREPARAMETERIPROC)(GLuint texture, GLenum pname, GLint param);
+typedef void (APIENTRYP PFNGLNAMEDBUFFERSUBDATAPROC)(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+static PFNGLBINDTEXTUREUNITPROC    glad_glBindTextureUnit    = nullptr;
+static PFNGLCREATETEXTURESPROC     glad_glCreateTextures     = nullptr;
+static PFNGLTEXTURESTORAGE2DPROC   glad_glTextureStorage2D   = nullptr;
+static PFNGLTEXTURESUBIMAGE2DPROC  glad_glTextureSubImage2D  = nullptr;
+static PFNGLTEXTUREPARAMETERIPROC  glad_glTextureParameteri  = nullptr;
+static PFNGLNAMEDBUFFERSUBDATAPROC glad_glNamedBufferSubData = nullptr;
+#define glBindTextureUnit    glad_glBindTextureUnit
+#define glCreateTextures     glad_glCreateTextures
+#define glTextureStorage2D   glad_glTextureStorage2D
+#define glTextureSubImage2D  glad_glTextureSubImage2D
+#define glTextureParameteri  glad_glTextureParameteri
+#define glNamedBufferSubData glad_glNamedBufferSubData
+#endif
+
+// core since 4.3, or through ARB_multi_draw_indirect
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER          0x8F3F
+#endif
+#ifndef glMultiDrawElementsIndirect
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+static PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect = nullptr;
+#define glMultiDrawElementsIndirect glad_glMultiDrawElementsIndirect
+#endif
+
+struct GLCapabilities {
+  // bc1 and bc3
+  bool s3tc = false;
+  // bc5, core since 3.0
+  bool rgtc = false;
+  // core since 4.3, or through ARB_ES3_compatibility
+  bool etc2 = false;
+  // immutable textures with glTexStorage2D
+  bool textureStorage = false;
+  // edits textures and buffers by name instead of binding them first
+  bool directStateAccess = false;
+  // many indexed draws from one buffer of commands, each with its own base instance
+  bool multiDrawIndirect = false;
+};
+
+GLCapabilities& glCapabilities() {
+  static GLCapabilities capabilities;
+  return capabilities;
+}
+
+bool hasGLExtension(const char* name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++) {
+    const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+    if (extension && std::strcmp(extension, name) == 0) return true;
+  }
+  return false;
+}
+
+static bool glVersionAtLeast(int major, int minor) {
+  return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+// `load` is the same loader glad was given
+void loadGLExtensions(GLADloadproc load) {
+  GLCapabilities& capabilities = glCapabilities();
+  capabilities.s3tc = hasGLExtension("GL_EXT_texture_compression_s3tc");
+  capabilities.rgtc = glVersionAtLeast(3, 0);
+  capabilities.etc2 = glVersionAtLeast(4, 3) || hasGLExtension("GL_ARB_ES3_compatibility");
+
+  if (glVersionAtLeast(4, 2) || hasGLExtension("GL_ARB_texture_storage"))
+    glad_glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)load("glTexStorage2D");
+  capabilities.textureStorage = glad_glTexStorage2D != nullptr;
+
+  if (glVersionAtLeast(4, 5) || hasGLExtension("GL_ARB_direct_state_access")) {
+    glad_glBindTextureUnit    = (PFNGLBINDTEXTUREUNITPROC)load("glBindTextureUnit");
+    glad_glCreateTextures     = (PFNGLCREATETEXTURESPROC)load("glCreateTextures");
+    glad_glTextureStorage2D   = (PFNGLTEXTURESTORAGE2DPROC)load("glTextureStorage2D");
+    glad_glTextureSubImage2D  = (PFNGLTEXTURESUBIMAGE2DPROC)load("glTextureSubImage2D");
+    glad_glTextureParameteri  = (PFNGLTEXTUREPARAMETERIPROC)load("glTextureParameteri");
+    glad_glNamedBufferSubData = (PFNGLNAMEDBUFFERSUBDATAPROC)load("glNamedBufferSubData");
+  }
+  capabilities.directStateAccess = glad_glBindTextureUnit && glad_glCreateTextures && glad_glTextureStorage2D &&
+      glad_glTextureSubImage2D && glad_glTextureParameteri && glad_glNamedBufferSubData;
+
+  // the extension alone doesn't promise a base instance other than 0, which instanced
+  // commands need, so before 4.2 it takes ARB_base_instance as well
+  if (glVersionAtLeast(4, 3) || (hasGLExtension("GL_ARB_multi_draw_indirect") &&
+      (glVersionAtLeast(4, 2) || hasGLExtension("GL_ARB_base_instance"))))
+    glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+  capabilities.multiDrawIndirect = glad_glMultiDrawElementsIndirect != nullptr;
+}
+
+bool compressedFormatSupported(GLenum internalFormat) {
+  const GLCapabilities& capabilities = glCapabilities();
+  switch (internalFormat) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return capabilities.s3tc;
+    case GL_COMPRESSED_RG_RGTC2:           return capabilities.rgtc;
+    case GL_COMPRESSED_RGB8_ETC2:          return capabilities.etc2;
+  }
+  return false;
+}
+
+#endif /* GLEXTENSIONS_H */
@@ -0,0 +1,257 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <sys/types.h>
+#include "glad/glad.h"
+#include "glExtensions.h"
+
+/*
+ * the gl state the renderer changes every frame, kept here so binding what's already
+ * bound never reaches the driver: the program, the vertex array, the 2d texture on each
+ * unit, the array, uniform and draw indirect buffer bindings, face culling, depth testing and writes,
+ * and blending
+ *
+ * everything that binds these goes through here, anything that calls gl directly has to
+ * invalidate() after. deleting an object unbinds it in gl, so deletes go through here
+ * too, or a new object given the old name would look bound already. element array
+ * bindings belong to the vertex array, they're passed straight through
+ *
+ * with direct state access textures are bound to their unit with glBindTextureUnit and
+ * buffers are updated by name, without the bind to edit. stats() counts the binds that
+ * got through and the ones dropped, main resets it every frame
+ *
+ * gl thread only
+ */
+
+#define GL_STATE_TEXTURE_UNITS 16
+// nothing is known about the binding, the next bind always goes through
+#define GL_STATE_UNKNOWN       0xffffffffu
+
+struct GLStateStats {
+  uint programBinds      = 0;
+  uint vertexArrayBinds  = 0;
+  uint textureBinds      = 0;
+  uint bufferBinds       = 0;
+  uint capabilityChanges = 0;
+  // calls that matched what was already set
+  uint skipped           = 0;
+
+  uint binds() const { return programBinds + vertexArrayBinds + textureBinds + bufferBinds + capabilityChanges; }
+  void reset() { *this = GLStateStats(); }
+};
+
+class GLState {
+  public:
+    GLState();
+
+    GLState(const GLState&) = delete;
+    GLState& operator=(const GLState&) = delete;
+
+    static GLState& shared();
+
+    void useProgram(uint program);
+    void bindVertexArray(uint vertexArray);
+    // a 2d texture onto a unit, for drawing
+    void bindTexture(uint unit, uint texture);
+    // onto whichever unit is active, to edit it
+    void bindTexture(uint texture);
+    void bindBuffer(GLenum target, uint buffer);
+    void bindBufferBase(GLenum target, uint index, uint buffer);
+    void bufferSubData(GLenum target, uint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+
+    void setCullFace(bool enabled);
+    void setDepthTest(bool enabled);
+    void setDepthWrite(bool enabled);
+    // straight alpha, src * a + dst * (1 - a)
+    void setBlend(bool enabled);
+
+    void deleteProgram(uint program);
+    void deleteVertexArray(uint vertexArray);
+    void deleteTexture(uint texture);
+    void deleteBuffer(uint buffer);
+
+    // forget everything, after gl was called around this
+    void invalidate();
+
+    GLStateStats& stats() { return _stats; }
+
+  private:
+    uint _program;
+    uint _vertexArray;
+    uint _activeUnit;
+    uint _textures[GL_STATE_TEXTURE_UNITS];
+    uint _arrayBuffer;
+    uint _uniformBuffer;
+    uint _drawIndirectBuffer;
+    // 0 off, 1 on, -1 unknown
+    int  _cullFace;
+    int  _depthTest;
+    int  _depthWrite;
+    int  _blend;
+
+    GLStateStats _stats;
+
+    void activeTexture(uint unit);
+    uint* bufferBinding(GLenum target);
+    void setCapability(GLenum capability, int& current, bool enabled);
+};
+
+GLState::GLState() {
+  invalidate();
+}
+
+GLState& GLState::shared() {
+  static GLState state;
+  return state;
+}
+
+void GLState::invalidate() {
+  _program = _vertexArray = _activeUnit = GL_STATE_UNKNOWN;
+  for (uint& texture : _textures) texture = GL_STATE_UNKNOWN;
+  _arrayBuffer = _uniformBuffer = _drawIndirectBuffer = GL_STATE_UNKNOWN;
+  _cullFace = _depthTest = _depthWrite = _blend = -1;
+}
+
+void GLState::useProgram(uint program) {
+  if (program == _program) {
+    _stats.skipped++;
+    return;
+  }
+  glUseProgram(program);
+  _program = program;
+  _stats.programBinds++;
+}
+
+void GLState::bindVertexArray(uint vertexArray) {
+  if (vertexArray == _vertexArray) {
+    _stats.skipped++;
+    return;
+  }
+  glBindVertexArray(vertexArray);
+  _vertexArray = vertexArray;
+  _stats.vertexArrayBinds++;
+}
+
+void GLState::activeTexture(uint unit) {
+  if (unit == _activeUnit) return;
+  glActiveTexture(GL_TEXTURE0 + unit);
+  _activeUnit = unit;
+}
+
+void GLState::bindTexture(uint unit, uint texture) {
+  uint* bound = unit < GL_STATE_TEXTURE_UNITS ? &_textures[unit] : nullptr;
+  if (bound && *bound == texture) {
+    _stats.skipped++;
+    return;
+  }
+
+  if (glCapabilities().directStateAccess) {
+    glBindTextureUnit(unit, texture);
+  } else {
+    activeTexture(unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+  }
+  if (bound) *bound = texture;
+  _stats.textureBinds++;
+}
+
+void GLState::bindTexture(uint texture) {
+  if (_activeUnit == GL_STATE_UNKNOWN) activeTexture(0);
+  bindTexture(_activeUnit, texture);
+}
+
+uint* GLState::bufferBinding(GLenum target) {
+  switch (target) {
+    case GL_ARRAY_BUFFER:         return &_arrayBuffer;
+    case GL_UNIFORM_BUFFER:       return &_uniformBuffer;
+    case GL_DRAW_INDIRECT_BUFFER: return &_drawIndirectBuffer;
+  }
+  return nullptr;
+}
+
+void GLState::bindBuffer(GLenum target, uint buffer) {
+  uint* bound = bufferBinding(target);
+  if (bound && *bound == buffer) {
+    _stats.skipped++;
+    return;
+  }
+  glBindBuffer(target, buffer);
+  if (bound) *bound = buffer;
+  _stats.bufferBinds++;
+}
+
+// binds the indexed point and, as gl does, the generic one too
+void GLState::bindBufferBase(GLenum target, uint index, uint buffer) {
+  glBindBufferBase(target, index, buffer);
+  if (uint* bound = bufferBinding(target)) *bound = buffer;
+  _stats.bufferBinds++;
+}
+
+void GLState::bufferSubData(GLenum target, uint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+  if (glCapabilities().directStateAccess) {
+    glNamedBufferSubData(buffer, offset, size, data);
+    return;
+  }
+  bindBuffer(target, buffer);
+  glBufferSubData(target, offset, size, data);
+}
+
+void GLState::setCapability(GLenum capability, int& current, bool enabled) {
+  if (current == (int)enabled) {
+    _stats.skipped++;
+    return;
+  }
+  if (enabled) glEnable(capability);
+  else         glDisable(capability);
+  current = enabled;
+  _stats.capabilityChanges++;
+}
+
+void GLState::setCullFace(bool enabled) {
+  setCapability(GL_CULL_FACE, _cullFace, enabled);
+}
+
+void GLState::setDepthTest(bool enabled) {
+  setCapability(GL_DEPTH_TEST, _depthTest, enabled);
+}
+
+void GLState::setDepthWrite(bool enabled) {
+  if (_depthWrite == (int)enabled) {
+    _stats.skipped++;
+    return;
+  }
+  glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+  _depthWrite = enabled;
+  _stats.capabilityChanges++;
+}
+
+void GLState::setBlend(bool enabled) {
+  // nothing else sets a blend function, so it only needs saying when blending turns on
+  if (enabled && _blend != 1) glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  setCapability(GL_BLEND, _blend, enabled);
+}
+
+void GLState::deleteProgram(uint program) {
+  glDeleteProgram(program);
+  // gl keeps a program in use until another is, so leave the cache alone: it's still bound
+}
+
+void GLState::deleteVertexArray(uint vertexArray) {
+  glDeleteVertexArrays(1, &vertexArray);
+  if (_vertexArray == vertexArray) _vertexArray = 0;
+}
+
+void GLState::deleteTexture(uint texture) {
+  glDeleteTextures(1, &texture);
+  for (uint& bound : _textures)
+    if (bound == texture) bound = 0;
+}
+
+void GLState::deleteBuffer(uint buffer) {
+  glDeleteBuffers(1, &buffer);
+  if (_arrayBuffer == buffer)        _arrayBuffer = 0;
+  if (_uniformBuffer == buffer)      _uniformBuffer = 0;
+  if (_drawIndirectBuffer == buffer) _drawIndirectBuffer = 0;
+}
+
+#endif /* GLSTATE_H */
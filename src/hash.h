@@ -0,0 +1,30 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "mappedFile.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME        0x100000001b3ULL
+
+// 64-bit FNV-1a, good enough for change detection and table keys
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS) {
+  const unsigned char* bytes = (const unsigned char*)data;
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+// 0 if the file can't be read
+uint64_t hashFile(const std::string& path) {
+  MappedFile file;
+  if (!file.open(path)) return 0;
+  return hashBytes(file.data(), file.size());
+}
+
+#endif /* HASH_H */
@@ -0,0 +1,115 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#ifndef STB_IMAGE_H
+#define STB_IMAGE_H
+#include "stb_image.h"
+#endif
+#include <string>
+#include <vector>
+#include <memory>
+#include "mappedFile.h"
+#include "loadProfiler.h"
+#include "hash.h"
+#include "ktx.h"
+#include "imageProcessing.h"
+
+// decoded pixels waiting to be uploaded, owns `data` until freeImage
+// loadImage hands back either the rgba mip chain built from them in `mips`, or the mapped
+// levels of a cooked ktx in `cooked`, and no `data`
+struct Image {
+  std::string    path;
+  int            width, height, channels;
+  unsigned char* data;
+  // of the encoded file, so the same picture under two names can be spotted
+  uint64_t       contentHash;
+  std::shared_ptr<KtxTexture> cooked;
+  std::shared_ptr<MipChain>   mips;
+};
+
+// safe to call from any thread, the flip flag is set per thread rather than globally
+Image decodeImage(std::string file, bool flip = true) {
+  LoadAsset asset(file);
+  Image image;
+  image.path = file;
+  image.width = image.height = image.channels = 0;
+  image.data = nullptr;
+  image.contentHash = 0;
+  image.cooked = nullptr;
+  image.mips = nullptr;
+
+  MappedFile encoded;
+  if (!encoded.open(file)) return image;
+
+  LoadTimer timer(LOAD_STAGE_DECODE);
+  image.contentHash = hashBytes(encoded.data(), encoded.size());
+  stbi_set_flip_vertically_on_load_thread(flip);
+  image.data = stbi_load_from_memory(encoded.data(), encoded.size(), &image.width, &image.height, &image.channels, 0);
+  return image;
+}
+
+// a cooked texture is only used if the driver takes its format and it's newer than its source
+static std::shared_ptr<KtxTexture> openCookedImage(const std::string& file, const std::string& cookedFile) {
+  // through fileModifiedTime so packed files keep the times they were packed with
+  int64_t cookedTime = fileModifiedTime(cookedFile);
+  if (cookedTime == 0 || fileModifiedTime(file) > cookedTime) return nullptr;
+
+  std::shared_ptr<KtxTexture> ktx = std::make_shared<KtxTexture>();
+  if (!ktx->open(cookedFile) || !compressedFormatSupported(ktx->internalFormat)) return nullptr;
+  return ktx;
+}
+
+// colour images are filtered in linear light, one and two channel ones are data
+MipOptions mipOptions(const Image& image) {
+  MipOptions options;
+  options.srgb = image.channels >= 3;
+  return options;
+}
+
+// replaces the decoded pixels with their rgba mip chain, on whichever thread is loading
+void buildImageMips(Image& image) {
+  if (!image.data) return;
+  LoadTimer timer(LOAD_STAGE_MIPS, image.path);
+  image.mips = std::make_shared<MipChain>(buildMipChain(image.data, image.width, image.height, image.channels, mipOptions(image)));
+  stbi_image_free(image.data);
+  image.data = nullptr;
+}
+
+// cooked ktx if there is a usable one (see textureCooker.h), decoded with its mip chain otherwise.
+// cooked files are stored flipped for gl, so they only stand in when flip is set
+Image loadImage(std::string file, bool flip = true) {
+  LoadAsset asset(file);
+  if (flip) {
+    for (const char* extension : { COOKED_BC_EXTENSION, COOKED_ETC2_EXTENSION }) {
+      std::shared_ptr<KtxTexture> ktx = openCookedImage(file, file + extension);
+      if (!ktx) continue;
+
+      Image image;
+      image.path = file;
+      image.width = ktx->width;
+      image.height = ktx->height;
+      image.channels = 0;
+      image.data = nullptr;
+      image.contentHash = hashBytes(ktx->fileData(), ktx->fileSize());
+      image.cooked = ktx;
+      LoadProfiler::shared().setCached(file);
+      return image;
+    }
+  }
+  Image image = decodeImage(file, flip);
+  buildImageMips(image);
+  return image;
+}
+
+bool imageLoaded(const Image& image) {
+  return image.data || image.cooked || image.mips;
+}
+
+void freeImage(Image& image) {
+  stbi_image_free(image.data);
+  image.data = nullptr;
+  image.cooked = nullptr;
+  image.mips = nullptr;
+}
+
+#endif /* IMAGE_H */
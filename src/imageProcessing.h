@@ -0,0 +1,503 @@
+#ifndef IMAGEPROCESSING_H
+#define IMAGEPROCESSING_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <sys/types.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * cpu side of texture loading: pixels to rgba8 and a whole mip chain, so the upload is
+ * aligned 4 byte rows and glGenerateMipmap isn't needed
+ *
+ *   expandToRgba      any channel count to rgba8
+ *   premultiplyAlpha  rgb *= a, in linear light for srgb images
+ *   downsampleBox     2x2 average
+ *   downsampleKaiser  8 tap kaiser windowed sinc per axis, sharper than box with less aliasing
+ *
+ * with srgb set colour is filtered in linear light and stored back as srgb, alpha is
+ * always linear. each kernel has a plain reference version (the *Scalar ones, also what
+ * the tails and odd sizes go through) and picks avx2, ssse3/sse2 or neon for the bulk at
+ * compile time, so build with SIMD_FLAGS (see makefile) to get the wider ones
+ *
+ * no gl here, this runs on the loading threads
+ */
+
+#define KAISER_TAPS   8
+#define KAISER_ALPHA  4.0
+// in destination texels, the taps reach 2 texels either side in the source level
+#define KAISER_RADIUS 2.0
+
+enum MipFilter {
+  MIP_FILTER_BOX,
+  MIP_FILTER_KAISER
+};
+
+struct MipOptions {
+  MipFilter filter = MIP_FILTER_BOX;
+  bool srgb = false;
+  bool premultiplyAlpha = false;
+};
+
+// rgba8, levels[0] at full size and each one after it half the size down to 1x1
+struct MipChain {
+  uint width, height;
+  std::vector<std::vector<uint8_t>> levels;
+
+  uint levelWidth(uint level) const  { return std::max(width >> level, 1u); }
+  uint levelHeight(uint level) const { return std::max(height >> level, 1u); }
+  size_t size() const {
+    size_t bytes = 0;
+    for (const std::vector<uint8_t>& level : levels) bytes += level.size();
+    return bytes;
+  }
+};
+
+// 16 bit linear both ways, the encode table is indexed with the linear value directly
+struct SrgbTables {
+  uint16_t toLinear[256];
+  float    toLinearFloat[256];
+  uint8_t  fromLinear[65536];
+
+  SrgbTables() {
+    for (uint i = 0; i < 256; i++) {
+      double c = i / 255.0;
+      double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+      toLinear[i] = (uint16_t)std::lround(linear * 65535.0);
+      toLinearFloat[i] = (float)linear;
+    }
+    for (uint i = 0; i < 65536; i++) {
+      double linear = i / 65535.0;
+      double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+      fromLinear[i] = (uint8_t)std::lround(c * 255.0);
+    }
+  }
+};
+
+static const SrgbTables& srgbTables() {
+  static const SrgbTables tables;
+  return tables;
+}
+
+// exact round(value / 255) for value <= 255 * 255
+static inline uint divide255(uint value) {
+  value += 128;
+  return (value + (value >> 8)) >> 8;
+}
+
+// ---- rgb/grey to rgba -------------------------------------------------------
+
+// missing colour channels are 0 and missing alpha opaque, a grey+alpha image keeps its
+// second channel in green so two channel maps survive
+void expandToRgbaScalar(const uint8_t* in, uint channels, uint8_t* out, size_t pixels) {
+  for (size_t i = 0; i < pixels; i++, in += channels, out += 4) {
+    out[0] = in[0];
+    out[1] = channels >= 2 ? in[1] : 0;
+    out[2] = channels >= 3 ? in[2] : 0;
+    out[3] = channels == 4 ? in[3] : 255;
+  }
+}
+
+void expandToRgba(const uint8_t* in, uint channels, uint8_t* out, size_t pixels) {
+  if (channels == 4) {
+    std::memcpy(out, in, pixels * 4);
+    return;
+  }
+  if (channels != 3) {
+    expandToRgbaScalar(in, channels, out, pixels);
+    return;
+  }
+
+  size_t i = 0;
+#if defined(__AVX2__)
+  // 8 pixels a go, the 24 bytes are split 12 per lane then shuffled in place.
+  // the load reads 32 bytes so stop while that's still inside the image
+  const __m256i split   = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+  const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                           0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i alpha   = _mm256_set1_epi32((int)0xFF000000);
+  for (; i + 11 <= pixels; i += 8) {
+    __m256i rgb = _mm256_loadu_si256((const __m256i*)(in + i * 3));
+    rgb = _mm256_permutevar8x32_epi32(rgb, split);
+    _mm256_storeu_si256((__m256i*)(out + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha));
+  }
+#elif defined(__SSSE3__)
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha   = _mm_set1_epi32((int)0xFF000000);
+  for (; i + 6 <= pixels; i += 4) {
+    __m128i rgb = _mm_loadu_si128((const __m128i*)(in + i * 3));
+    _mm_storeu_si128((__m128i*)(out + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t alpha = vdupq_n_u8(255);
+  for (; i + 16 <= pixels; i += 16) {
+    uint8x16x3_t rgb = vld3q_u8(in + i * 3);
+    uint8x16x4_t rgba = { { rgb.val[0], rgb.val[1], rgb.val[2], alpha } };
+    vst4q_u8(out + i * 4, rgba);
+  }
+#endif
+  expandToRgbaScalar(in + i * 3, 3, out + i * 4, pixels - i);
+}
+
+// ---- premultiplied alpha ----------------------------------------------------
+
+void premultiplyAlphaScalar(uint8_t* rgba, size_t pixels, bool srgb) {
+  const SrgbTables& tables = srgbTables();
+  for (size_t i = 0; i < pixels; i++, rgba += 4) {
+    uint a = rgba[3];
+    for (uint c = 0; c < 3; c++) {
+      if (srgb) rgba[c] = tables.fromLinear[(tables.toLinear[rgba[c]] * a + 127) / 255];
+      else      rgba[c] = divide255(rgba[c] * a);
+    }
+  }
+}
+
+void premultiplyAlpha(uint8_t* rgba, size_t pixels, bool srgb) {
+  // srgb goes through the tables, which don't vectorise
+  if (srgb) {
+    premultiplyAlphaScalar(rgba, pixels, srgb);
+    return;
+  }
+
+  size_t i = 0;
+#if defined(__AVX2__)
+  // alpha is multiplied by 255, which divide255 gives back unchanged
+  const __m256i keepAlpha = _mm256_set1_epi64x(0x00FF000000000000ll);
+  const __m256i colour    = _mm256_set1_epi64x(0x0000FFFFFFFFFFFFll);
+  const __m256i bias      = _mm256_set1_epi16(128);
+  const __m256i zero      = _mm256_setzero_si256();
+  for (; i + 8 <= pixels; i += 8) {
+    __m256i pixels8 = _mm256_loadu_si256((const __m256i*)(rgba + i * 4));
+    __m256i result[2];
+    for (uint half = 0; half < 2; half++) {
+      __m256i wide = half ? _mm256_unpackhi_epi8(pixels8, zero) : _mm256_unpacklo_epi8(pixels8, zero);
+      __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(wide, 0xFF), 0xFF);
+      a = _mm256_or_si256(_mm256_and_si256(a, colour), keepAlpha);
+      __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(wide, a), bias);
+      result[half] = _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+    }
+    _mm256_storeu_si256((__m256i*)(rgba + i * 4), _mm256_packus_epi16(result[0], result[1]));
+  }
+#elif defined(__SSE2__)
+  const __m128i keepAlpha = _mm_set1_epi64x(0x00FF000000000000ll);
+  const __m128i colour    = _mm_set1_epi64x(0x0000FFFFFFFFFFFFll);
+  const __m128i bias      = _mm_set1_epi16(128);
+  const __m128i zero      = _mm_setzero_si128();
+  for (; i + 4 <= pixels; i += 4) {
+    __m128i pixels4 = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+    __m128i result[2];
+    for (uint half = 0; half < 2; half++) {
+      __m128i wide = half ? _mm_unpackhi_epi8(pixels4, zero) : _mm_unpacklo_epi8(pixels4, zero);
+      __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(wide, 0xFF), 0xFF);
+      a = _mm_or_si128(_mm_and_si128(a, colour), keepAlpha);
+      __m128i product = _mm_add_epi16(_mm_mullo_epi16(wide, a), bias);
+      result[half] = _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+    }
+    _mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_packus_epi16(result[0], result[1]));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= pixels; i += 16) {
+    uint8x16x4_t p = vld4q_u8(rgba + i * 4);
+    for (uint c = 0; c < 3; c++) {
+      uint16x8_t lo = vaddq_u16(vmull_u8(vget_low_u8(p.val[c]),  vget_low_u8(p.val[3])),  vdupq_n_u16(128));
+      uint16x8_t hi = vaddq_u16(vmull_u8(vget_high_u8(p.val[c]), vget_high_u8(p.val[3])), vdupq_n_u16(128));
+      p.val[c] = vcombine_u8(vshrn_n_u16(vsraq_n_u16(lo, lo, 8), 8), vshrn_n_u16(vsraq_n_u16(hi, hi, 8), 8));
+    }
+    vst4q_u8(rgba + i * 4, p);
+  }
+#endif
+  premultiplyAlphaScalar(rgba + i * 4, pixels - i, srgb);
+}
+
+// ---- box ----------------------------------------------------------------------
+
+// one destination row, odd sizes drop the last source column like the row clamp below does
+static void downsampleBoxRowScalar(const uint8_t* row0, const uint8_t* row1, uint width, uint8_t* out,
+                                   uint first, uint last, bool srgb) {
+  const SrgbTables& tables = srgbTables();
+  for (uint x = first; x < last; x++) {
+    uint x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+    const uint8_t* a = row0 + x0 * 4; const uint8_t* b = row0 + x1 * 4;
+    const uint8_t* c = row1 + x0 * 4; const uint8_t* d = row1 + x1 * 4;
+    for (uint channel = 0; channel < 4; channel++) {
+      if (srgb && channel < 3) {
+        uint sum = tables.toLinear[a[channel]] + tables.toLinear[b[channel]] + tables.toLinear[c[channel]] + tables.toLinear[d[channel]];
+        out[x * 4 + channel] = tables.fromLinear[(sum + 2) / 4];
+      } else {
+        out[x * 4 + channel] = (a[channel] + b[channel] + c[channel] + d[channel] + 2) / 4;
+      }
+    }
+  }
+}
+
+void downsampleBoxScalar(const uint8_t* in, uint width, uint height, uint8_t* out, bool srgb) {
+  uint w = std::max(width / 2, 1u), h = std::max(height / 2, 1u);
+  for (uint y = 0; y < h; y++) {
+    const uint8_t* row0 = in + (size_t)std::min(y * 2, height - 1) * width * 4;
+    const uint8_t* row1 = in + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+    downsampleBoxRowScalar(row0, row1, width, out + (size_t)y * w * 4, 0, w, srgb);
+  }
+}
+
+void downsampleBox(const uint8_t* in, uint width, uint height, uint8_t* out, bool srgb) {
+  if (srgb || width < 2) {
+    downsampleBoxScalar(in, width, height, out, srgb);
+    return;
+  }
+
+  uint w = width / 2, h = std::max(height / 2, 1u);
+  for (uint y = 0; y < h; y++) {
+    const uint8_t* row0 = in + (size_t)std::min(y * 2, height - 1) * width * 4;
+    const uint8_t* row1 = in + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+    uint8_t* row = out + (size_t)y * w * 4;
+    uint x = 0;
+
+    // widen to 16 bit, add the rows, then add each pixel to its right hand neighbour by
+    // pairing up the 64 bit halves
+#if defined(__AVX2__)
+    const __m256i bias = _mm256_set1_epi16(2);
+    const __m256i zero = _mm256_setzero_si256();
+    for (; x + 4 <= w; x += 4) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(row0 + x * 8));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(row1 + x * 8));
+      __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+      __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+      __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+      sum = _mm256_srli_epi16(_mm256_add_epi16(sum, bias), 2);
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0x08);
+      _mm_storeu_si128((__m128i*)(row + x * 4), _mm256_castsi256_si128(packed));
+    }
+#elif defined(__SSE2__)
+    const __m128i bias = _mm_set1_epi16(2);
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 2 <= w; x += 2) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+      __m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+      __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+      __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+      __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+      sum = _mm_srli_epi16(_mm_add_epi16(sum, bias), 2);
+      _mm_storel_epi64((__m128i*)(row + x * 4), _mm_packus_epi16(sum, sum));
+    }
+#elif defined(__ARM_NEON)
+    for (; x + 2 <= w; x += 2) {
+      uint16x8_t lo = vaddl_u8(vld1_u8(row0 + x * 8),     vld1_u8(row1 + x * 8));
+      uint16x8_t hi = vaddl_u8(vld1_u8(row0 + x * 8 + 8), vld1_u8(row1 + x * 8 + 8));
+      uint16x4_t first  = vadd_u16(vget_low_u16(lo), vget_high_u16(lo));
+      uint16x4_t second = vadd_u16(vget_low_u16(hi), vget_high_u16(hi));
+      vst1_u8(row + x * 4, vrshrn_n_u16(vcombine_u16(first, second), 2));
+    }
+#endif
+    downsampleBoxRowScalar(row0, row1, width, row, x, w, false);
+  }
+}
+
+// ---- kaiser -----------------------------------------------------------------
+
+static double besselI0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (uint k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+// destination texel x covers source texels 2x-3 .. 2x+4, the same weights for every x
+static const float* kaiserWeights() {
+  static const std::vector<float> weights = []() {
+    std::vector<float> weights(KAISER_TAPS);
+    double total = 0.0;
+    for (uint k = 0; k < KAISER_TAPS; k++) {
+      double d = (k - (KAISER_TAPS - 1) * 0.5) * 0.5;
+      double sinc = d == 0.0 ? 1.0 : std::sin(M_PI * d) / (M_PI * d);
+      double t = d / KAISER_RADIUS;
+      double window = besselI0(KAISER_ALPHA * std::sqrt(std::max(0.0, 1.0 - t * t))) / besselI0(KAISER_ALPHA);
+      weights[k] = sinc * window;
+      total += weights[k];
+    }
+    for (float& weight : weights) weight /= total;
+    return weights;
+  }();
+  return weights.data();
+}
+
+static void linearRow(const uint8_t* in, uint width, const float* toLinear, float* out) {
+  for (uint i = 0; i < width * 4; i += 4) {
+    out[i]     = toLinear[in[i]];
+    out[i + 1] = toLinear[in[i + 1]];
+    out[i + 2] = toLinear[in[i + 2]];
+    out[i + 3] = in[i + 3] * (1.0f / 255.0f);
+  }
+}
+
+// one pixel is one float4, so a vector is a pixel and the taps are multiply-adds
+template <bool Vectorized>
+static void kaiserRow(const float* in, uint width, float* out, uint outWidth) {
+  const float* weights = kaiserWeights();
+  const int first = -(KAISER_TAPS / 2 - 1);
+
+  for (uint x = 0; x < outWidth; x++) {
+    int start = (int)x * 2 + first;
+    bool inside = start >= 0 && start + KAISER_TAPS <= (int)width;
+
+#if defined(__SSE2__)
+    if (Vectorized) {
+      __m128 sum = _mm_setzero_ps();
+      for (int k = 0; k < KAISER_TAPS; k++) {
+        int sx = inside ? start + k : std::clamp(start + k, 0, (int)width - 1);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(in + sx * 4)));
+      }
+      _mm_storeu_ps(out + x * 4, sum);
+      continue;
+    }
+#elif defined(__ARM_NEON)
+    if (Vectorized) {
+      float32x4_t sum = vdupq_n_f32(0.0f);
+      for (int k = 0; k < KAISER_TAPS; k++) {
+        int sx = inside ? start + k : std::clamp(start + k, 0, (int)width - 1);
+        sum = vmlaq_n_f32(sum, vld1q_f32(in + sx * 4), weights[k]);
+      }
+      vst1q_f32(out + x * 4, sum);
+      continue;
+    }
+#endif
+    for (uint c = 0; c < 4; c++) {
+      float sum = 0.0f;
+      for (int k = 0; k < KAISER_TAPS; k++)
+        sum += weights[k] * in[std::clamp(start + k, 0, (int)width - 1) * 4 + c];
+      out[x * 4 + c] = sum;
+    }
+  }
+}
+
+// weighted sum of KAISER_TAPS filtered rows, straight runs of floats
+template <bool Vectorized>
+static void kaiserColumn(const float* const* rows, uint count, float* out) {
+  const float* weights = kaiserWeights();
+  uint i = 0;
+
+#if defined(__AVX2__)
+  if (Vectorized) {
+    for (; i + 8 <= count; i += 8) {
+      __m256 sum = _mm256_setzero_ps();
+      for (uint k = 0; k < KAISER_TAPS; k++)
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i)));
+      _mm256_storeu_ps(out + i, sum);
+    }
+  }
+#elif defined(__SSE2__)
+  if (Vectorized) {
+    for (; i + 4 <= count; i += 4) {
+      __m128 sum = _mm_setzero_ps();
+      for (uint k = 0; k < KAISER_TAPS; k++)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+      _mm_storeu_ps(out + i, sum);
+    }
+  }
+#elif defined(__ARM_NEON)
+  if (Vectorized) {
+    for (; i + 4 <= count; i += 4) {
+      float32x4_t sum = vdupq_n_f32(0.0f);
+      for (uint k = 0; k < KAISER_TAPS; k++)
+        sum = vmlaq_n_f32(sum, vld1q_f32(rows[k] + i), weights[k]);
+      vst1q_f32(out + i, sum);
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    float sum = 0.0f;
+    for (uint k = 0; k < KAISER_TAPS; k++) sum += weights[k] * rows[k][i];
+    out[i] = sum;
+  }
+}
+
+template <bool Vectorized>
+static void kaiserDownsample(const uint8_t* in, uint width, uint height, uint8_t* out, bool srgb) {
+  const SrgbTables& tables = srgbTables();
+  float unorm[256];
+  for (uint i = 0; i < 256; i++) unorm[i] = i / 255.0f;
+  const float* toLinear = srgb ? tables.toLinearFloat : unorm;
+
+  uint w = std::max(width / 2, 1u), h = std::max(height / 2, 1u);
+  const int first = -(KAISER_TAPS / 2 - 1);
+
+  // each output row needs KAISER_TAPS source rows and shares all but two with the one
+  // before it, so the horizontally filtered rows are kept in a ring keyed by source row
+  std::vector<float> source(width * 4);
+  std::vector<std::vector<float>> filtered(KAISER_TAPS, std::vector<float>(w * 4));
+  std::vector<int> filteredRow(KAISER_TAPS, -1);
+  std::vector<float> column(w * 4);
+  const float* rows[KAISER_TAPS];
+
+  for (uint y = 0; y < h; y++) {
+    for (int k = 0; k < KAISER_TAPS; k++) {
+      int sy = std::clamp((int)y * 2 + first + k, 0, (int)height - 1);
+      uint slot = sy % KAISER_TAPS;
+      if (filteredRow[slot] != sy) {
+        linearRow(in + (size_t)sy * width * 4, width, toLinear, source.data());
+        kaiserRow<Vectorized>(source.data(), width, filtered[slot].data(), w);
+        filteredRow[slot] = sy;
+      }
+      rows[k] = filtered[slot].data();
+    }
+    kaiserColumn<Vectorized>(rows, w * 4, column.data());
+
+    // the negative lobes can overshoot, clamp on the way back to bytes
+    uint8_t* row = out + (size_t)y * w * 4;
+    for (uint i = 0; i < w * 4; i++) {
+      float value = std::clamp(column[i], 0.0f, 1.0f);
+      if (srgb && i % 4 != 3) row[i] = tables.fromLinear[(uint)(value * 65535.0f + 0.5f)];
+      else                    row[i] = (uint8_t)(value * 255.0f + 0.5f);
+    }
+  }
+}
+
+void downsampleKaiserScalar(const uint8_t* in, uint width, uint height, uint8_t* out, bool srgb) {
+  kaiserDownsample<false>(in, width, height, out, srgb);
+}
+
+void downsampleKaiser(const uint8_t* in, uint width, uint height, uint8_t* out, bool srgb) {
+  kaiserDownsample<true>(in, width, height, out, srgb);
+}
+
+// ---- mip chain --------------------------------------------------------------
+
+MipChain buildMipChain(const uint8_t* pixels, uint width, uint height, uint channels, const MipOptions& options = MipOptions()) {
+  MipChain chain;
+  chain.width = width;
+  chain.height = height;
+
+  chain.levels.emplace_back((size_t)width * height * 4);
+  expandToRgba(pixels, channels, chain.levels[0].data(), (size_t)width * height);
+  if (options.premultiplyAlpha && channels == 4)
+    premultiplyAlpha(chain.levels[0].data(), (size_t)width * height, options.srgb);
+
+  uint w = width, h = height;
+  while (w > 1 || h > 1) {
+    uint nextWidth = std::max(w / 2, 1u), nextHeight = std::max(h / 2, 1u);
+    std::vector<uint8_t> next((size_t)nextWidth * nextHeight * 4);
+    if (options.filter == MIP_FILTER_KAISER) downsampleKaiser(chain.levels.back().data(), w, h, next.data(), options.srgb);
+    else                                     downsampleBox(chain.levels.back().data(), w, h, next.data(), options.srgb);
+    chain.levels.push_back(std::move(next));
+    w = nextWidth;
+    h = nextHeight;
+  }
+  return chain;
+}
+
+#endif /* IMAGEPROCESSING_H */
@@ -0,0 +1,201 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+#include "glExtensions.h"
+#include "glState.h"
+#include "mappedFile.h"
+
+/*
+ * KTX 1.1 container for cooked, block compressed textures with their whole mip chain
+ *
+ *   identifier, 13 uint32 header fields, key/value data
+ *   per mip level: uint32 imageSize, imageSize bytes (padded to 4)
+ *
+ * only what the cooker writes is read back: 2d, one face, no array, compressed,
+ * little endian. the file is mapped and the levels handed straight to
+ * glCompressedTexImage2D. cooked files sit next to their source with the format
+ * in the name (asteroid1.jpg -> asteroid1.jpg.bc.ktx)
+ */
+
+#define COOKED_BC_EXTENSION   ".bc.ktx"
+#define COOKED_ETC2_EXTENSION ".etc2.ktx"
+
+static const uint8_t KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+#define KTX_ENDIANNESS 0x04030201
+
+struct KtxHeader {
+  uint8_t  identifier[12];
+  uint32_t endianness;
+  uint32_t glType;
+  uint32_t glTypeSize;
+  uint32_t glFormat;
+  uint32_t glInternalFormat;
+  uint32_t glBaseInternalFormat;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t numberOfArrayElements;
+  uint32_t numberOfFaces;
+  uint32_t numberOfMipmapLevels;
+  uint32_t bytesOfKeyValueData;
+};
+
+struct KtxLevel {
+  uint                 width, height;
+  const unsigned char* data;
+  uint32_t             size;
+};
+
+class KtxTexture {
+  public:
+    // maps the file, false if it isn't a ktx this can read
+    bool open(const std::string& path);
+
+    uint32_t internalFormat;
+    uint32_t width, height;
+    std::vector<KtxLevel> levels;
+
+    const unsigned char* fileData() const;
+    size_t fileSize() const;
+    // compressed bytes over all levels, what it costs in video memory
+    size_t dataSize() const;
+
+  private:
+    MappedFile _file;
+};
+
+bool KtxTexture::open(const std::string& path) {
+  if (!_file.open(path)) return false;
+
+  const unsigned char* data = _file.data();
+  size_t size = _file.size();
+  if (size < sizeof(KtxHeader)) return false;
+
+  const KtxHeader* header = (const KtxHeader*)data;
+  if (std::memcmp(header->identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 ||
+      header->endianness != KTX_ENDIANNESS || header->glType != 0 ||
+      header->pixelDepth > 1 || header->numberOfFaces != 1 || header->numberOfArrayElements > 1) {
+    std::cout << "ERROR::KTX::UNSUPPORTED '" << path << "'" << std::endl;
+    return false;
+  }
+
+  internalFormat = header->glInternalFormat;
+  width  = header->pixelWidth;
+  height = header->pixelHeight;
+  levels.clear();
+
+  size_t offset = sizeof(KtxHeader) + header->bytesOfKeyValueData;
+  for (uint32_t level = 0; level < std::max(header->numberOfMipmapLevels, 1u); level++) {
+    if (offset + sizeof(uint32_t) > size) break;
+    uint32_t imageSize;
+    std::memcpy(&imageSize, data + offset, sizeof(imageSize));
+    offset += sizeof(uint32_t);
+    if (offset + imageSize > size) break;
+
+    levels.push_back({ std::max(width >> level, 1u), std::max(height >> level, 1u), data + offset, imageSize });
+    offset += (imageSize + 3) & ~3u;
+  }
+
+  if (levels.size() != std::max(header->numberOfMipmapLevels, 1u)) {
+    std::cout << "ERROR::KTX::TRUNCATED '" << path << "'" << std::endl;
+    levels.clear();
+    return false;
+  }
+  return true;
+}
+
+const unsigned char* KtxTexture::fileData() const {
+  return _file.data();
+}
+
+size_t KtxTexture::fileSize() const {
+  return _file.size();
+}
+
+size_t KtxTexture::dataSize() const {
+  size_t size = 0;
+  for (const KtxLevel& level : levels) size += level.size;
+  return size;
+}
+
+// levels[0] is the full size image, each one after it half the size down to 1x1
+bool writeKtx(const std::string& path, uint32_t internalFormat, uint32_t baseInternalFormat,
+              uint width, uint height, const std::vector<std::vector<uint8_t>>& levels) {
+  // the cooker flips images for gl on decode, so t points up
+  static const char orientationKey[] = "KTXorientation";
+  static const char orientationValue[] = "S=r,T=u";
+  uint32_t keyValueSize = sizeof(orientationKey) + sizeof(orientationValue);
+  uint32_t keyValuePadded = (keyValueSize + 3) & ~3u;
+
+  KtxHeader header;
+  std::memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+  header.endianness            = KTX_ENDIANNESS;
+  header.glType                = 0;
+  header.glTypeSize            = 1;
+  header.glFormat              = 0;
+  header.glInternalFormat      = internalFormat;
+  header.glBaseInternalFormat  = baseInternalFormat;
+  header.pixelWidth            = width;
+  header.pixelHeight           = height;
+  header.pixelDepth            = 0;
+  header.numberOfArrayElements = 0;
+  header.numberOfFaces         = 1;
+  header.numberOfMipmapLevels  = levels.size();
+  header.bytesOfKeyValueData   = sizeof(uint32_t) + keyValuePadded;
+
+  // same temporary and rename as the mesh cache, a crash never leaves half a texture behind
+  std::string tempPath = path + ".tmp";
+  std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+  if (!out) return false;
+
+  const char padding[4] = {};
+  out.write((const char*)&header, sizeof(header));
+  out.write((const char*)&keyValueSize, sizeof(keyValueSize));
+  out.write(orientationKey, sizeof(orientationKey));
+  out.write(orientationValue, sizeof(orientationValue));
+  out.write(padding, keyValuePadded - keyValueSize);
+
+  for (const std::vector<uint8_t>& level : levels) {
+    uint32_t imageSize = level.size();
+    out.write((const char*)&imageSize, sizeof(imageSize));
+    out.write((const char*)level.data(), level.size());
+    out.write(padding, ((imageSize + 3) & ~3u) - imageSize);
+  }
+
+  out.close();
+  if (!out || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+    std::remove(tempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+// gl thread, every level straight from the mapping
+uint uploadKtx(const KtxTexture& ktx) {
+  uint texture;
+  glGenTextures(1, &texture);
+  GLState::shared().bindTexture(texture);
+
+  for (uint level = 0; level < ktx.levels.size(); level++) {
+    const KtxLevel& image = ktx.levels[level];
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx.internalFormat, image.width, image.height, 0, image.size, image.data);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ktx.levels.size() - 1);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  return texture;
+}
+
+#endif /* KTX_H */
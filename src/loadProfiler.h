@@ -0,0 +1,313 @@
+#ifndef LOADPROFILER_H
+#define LOADPROFILER_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sys/types.h>
+#include "threadPool.h"
+
+/*
+ * where startup time goes: wall time per stage and per asset, bytes read and uploaded,
+ * and how busy the loading threads were
+ *
+ *   LoadAsset   scope naming the asset the work inside it is for, per thread. file reads
+ *               outside of one are put down to the file, anything else to LOAD_PROFILE_OTHER
+ *   LoadTimer   scope timing one stage. timers nest, a stage's time doesn't include the
+ *               stages timed inside it, so the stages add up to at most the wall time
+ *
+ * begin() and finish() bracket the load, report() prints it and writeJson() writes it
+ * out for CI (main does when LOAD_PROFILE_JSON names a file), so cold and warm loads
+ * can be tracked per asset. safe to use from any thread
+ */
+
+enum LoadStage {
+  LOAD_STAGE_READ,
+  LOAD_STAGE_PARSE,
+  LOAD_STAGE_PROCESS,
+  LOAD_STAGE_CACHE_WRITE,
+  LOAD_STAGE_DECODE,
+  LOAD_STAGE_MIPS,
+  LOAD_STAGE_MESH_UPLOAD,
+  LOAD_STAGE_TEXTURE_UPLOAD,
+  LOAD_STAGE_SHADER_COMPILE,
+  LOAD_STAGE_COUNT
+};
+
+#define LOAD_PROFILE_OTHER "(other)"
+
+static const char* LOAD_STAGE_NAMES[LOAD_STAGE_COUNT] = {
+  "read", "parse", "process", "cache write", "decode", "mips", "mesh upload", "texture upload", "shader compile"
+};
+
+struct LoadAssetProfile {
+  double milliseconds[LOAD_STAGE_COUNT] = {};
+  size_t bytesRead     = 0;
+  size_t bytesUploaded = 0;
+  // came out of the mesh cache or a cooked texture rather than its source
+  bool   cached        = false;
+
+  double total() const;
+};
+
+class LoadProfiler {
+  public:
+    LoadProfiler();
+
+    LoadProfiler(const LoadProfiler&) = delete;
+    LoadProfiler& operator=(const LoadProfiler&) = delete;
+
+    static LoadProfiler& shared();
+
+    void begin();
+    void finish();
+
+    void addTime(const std::string& asset, LoadStage stage, double milliseconds);
+    void addRead(const std::string& asset, size_t bytes);
+    void addUpload(const std::string& asset, size_t bytes);
+    void setCached(const std::string& asset);
+
+    // the innermost LoadAsset on this thread, empty outside of one
+    static const std::string& currentAsset();
+
+    void report();
+    bool writeJson(const std::string& path);
+
+  private:
+    std::mutex _mutex;
+    std::map<std::string, LoadAssetProfile> _assets;
+    std::chrono::steady_clock::time_point _start, _end;
+    double _poolBusyStart, _poolBusy;
+
+    double wallMilliseconds();
+    // share of the pool's threads' time between begin and finish spent running jobs
+    double utilization();
+    LoadAssetProfile totals();
+};
+
+class LoadAsset {
+  public:
+    LoadAsset(const std::string& asset);
+    ~LoadAsset();
+
+    LoadAsset(const LoadAsset&) = delete;
+    LoadAsset& operator=(const LoadAsset&) = delete;
+
+  private:
+    std::string _previous;
+
+    friend class LoadProfiler;
+    static std::string& current();
+};
+
+class LoadTimer {
+  public:
+    // asset defaults to the current LoadAsset
+    LoadTimer(LoadStage stage, const std::string& asset = "");
+    ~LoadTimer();
+
+    LoadTimer(const LoadTimer&) = delete;
+    LoadTimer& operator=(const LoadTimer&) = delete;
+
+  private:
+    LoadStage   _stage;
+    std::string _asset;
+    std::chrono::steady_clock::time_point _start;
+    // time spent in timers nested inside this one
+    double      _nested;
+    LoadTimer*  _parent;
+
+    static LoadTimer*& current();
+};
+
+double LoadAssetProfile::total() const {
+  double sum = 0.0;
+  for (double stage : milliseconds) sum += stage;
+  return sum;
+}
+
+LoadProfiler::LoadProfiler()
+  : _start(std::chrono::steady_clock::now()), _end(_start), _poolBusyStart(0.0), _poolBusy(0.0) {
+}
+
+LoadProfiler& LoadProfiler::shared() {
+  static LoadProfiler profiler;
+  return profiler;
+}
+
+void LoadProfiler::begin() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _assets.clear();
+  _start = _end = std::chrono::steady_clock::now();
+  _poolBusyStart = ThreadPool::shared().busyMilliseconds();
+  _poolBusy = 0.0;
+}
+
+void LoadProfiler::finish() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _end = std::chrono::steady_clock::now();
+  _poolBusy = ThreadPool::shared().busyMilliseconds() - _poolBusyStart;
+}
+
+void LoadProfiler::addTime(const std::string& asset, LoadStage stage, double milliseconds) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _assets[asset.empty() ? LOAD_PROFILE_OTHER : asset].milliseconds[stage] += milliseconds;
+}
+
+void LoadProfiler::addRead(const std::string& asset, size_t bytes) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _assets[asset.empty() ? LOAD_PROFILE_OTHER : asset].bytesRead += bytes;
+}
+
+void LoadProfiler::addUpload(const std::string& asset, size_t bytes) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _assets[asset.empty() ? LOAD_PROFILE_OTHER : asset].bytesUploaded += bytes;
+}
+
+void LoadProfiler::setCached(const std::string& asset) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _assets[asset.empty() ? LOAD_PROFILE_OTHER : asset].cached = true;
+}
+
+const std::string& LoadProfiler::currentAsset() {
+  return LoadAsset::current();
+}
+
+double LoadProfiler::wallMilliseconds() {
+  return std::chrono::duration<double, std::milli>(_end - _start).count();
+}
+
+double LoadProfiler::utilization() {
+  double available = wallMilliseconds() * ThreadPool::shared().size();
+  return available > 0.0 ? _poolBusy / available : 0.0;
+}
+
+LoadAssetProfile LoadProfiler::totals() {
+  LoadAssetProfile totals;
+  for (auto& entry : _assets) {
+    for (int stage = 0; stage < LOAD_STAGE_COUNT; stage++) totals.milliseconds[stage] += entry.second.milliseconds[stage];
+    totals.bytesRead     += entry.second.bytesRead;
+    totals.bytesUploaded += entry.second.bytesUploaded;
+  }
+  return totals;
+}
+
+void LoadProfiler::report() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  LoadAssetProfile all = totals();
+  char line[256];
+
+  std::snprintf(line, sizeof(line), "%.1f ms wall, %u loading threads %.0f%% busy, %.2f MiB read, %.2f MiB uploaded",
+      wallMilliseconds(), ThreadPool::shared().size(), utilization() * 100.0,
+      all.bytesRead / 1048576.0, all.bytesUploaded / 1048576.0);
+  std::cout << "INFO::LOADPROFILE::" << line << std::endl;
+
+  for (int stage = 0; stage < LOAD_STAGE_COUNT; stage++) {
+    if (all.milliseconds[stage] == 0.0) continue;
+    std::snprintf(line, sizeof(line), "%-15s %9.1f ms", LOAD_STAGE_NAMES[stage], all.milliseconds[stage]);
+    std::cout << "INFO::LOADPROFILE::STAGE " << line << std::endl;
+  }
+
+  for (auto& entry : _assets) {
+    const LoadAssetProfile& asset = entry.second;
+    std::snprintf(line, sizeof(line), "%9.1f ms, %8.2f MiB read, %8.2f MiB uploaded%s",
+        asset.total(), asset.bytesRead / 1048576.0, asset.bytesUploaded / 1048576.0, asset.cached ? ", cached" : "");
+    std::cout << "INFO::LOADPROFILE::ASSET '" << entry.first << "' " << line << std::endl;
+  }
+}
+
+static std::string jsonString(const std::string& text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') quoted.push_back('\\');
+    if ((unsigned char)c < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      quoted += escaped;
+      continue;
+    }
+    quoted.push_back(c);
+  }
+  return quoted + "\"";
+}
+
+static void writeJsonStages(std::ofstream& out, const LoadAssetProfile& profile) {
+  out << "{";
+  for (int stage = 0; stage < LOAD_STAGE_COUNT; stage++)
+    out << (stage ? ", " : "") << jsonString(LOAD_STAGE_NAMES[stage]) << ": " << profile.milliseconds[stage];
+  out << "}";
+}
+
+bool LoadProfiler::writeJson(const std::string& path) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::ofstream out(path, std::ios::trunc);
+  if (!out) {
+    std::cout << "ERROR::LOADPROFILE::WRITE_FAILED '" << path << "'" << std::endl;
+    return false;
+  }
+
+  LoadAssetProfile all = totals();
+  out << "{\n";
+  out << "  \"wallMs\": " << wallMilliseconds() << ",\n";
+  out << "  \"threads\": " << ThreadPool::shared().size() << ",\n";
+  out << "  \"utilization\": " << utilization() << ",\n";
+  out << "  \"bytesRead\": " << all.bytesRead << ",\n";
+  out << "  \"bytesUploaded\": " << all.bytesUploaded << ",\n";
+  out << "  \"stagesMs\": ";
+  writeJsonStages(out, all);
+  out << ",\n  \"assets\": [";
+
+  bool first = true;
+  for (auto& entry : _assets) {
+    const LoadAssetProfile& asset = entry.second;
+    out << (first ? "\n" : ",\n") << "    {\"path\": " << jsonString(entry.first)
+        << ", \"cached\": " << (asset.cached ? "true" : "false")
+        << ", \"totalMs\": " << asset.total()
+        << ", \"bytesRead\": " << asset.bytesRead
+        << ", \"bytesUploaded\": " << asset.bytesUploaded
+        << ", \"stagesMs\": ";
+    writeJsonStages(out, asset);
+    out << "}";
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+  return (bool)out;
+}
+
+LoadAsset::LoadAsset(const std::string& asset)
+  : _previous(current()) {
+  current() = asset;
+}
+
+LoadAsset::~LoadAsset() {
+  current() = _previous;
+}
+
+std::string& LoadAsset::current() {
+  thread_local std::string asset;
+  return asset;
+}
+
+LoadTimer::LoadTimer(LoadStage stage, const std::string& asset)
+  : _stage(stage), _asset(asset.empty() ? LoadProfiler::currentAsset() : asset),
+    _start(std::chrono::steady_clock::now()), _nested(0.0), _parent(current()) {
+  current() = this;
+}
+
+LoadTimer::~LoadTimer() {
+  double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+  LoadProfiler::shared().addTime(_asset, _stage, elapsed - _nested);
+  if (_parent) _parent->_nested += elapsed;
+  current() = _parent;
+}
+
+LoadTimer*& LoadTimer::current() {
+  thread_local LoadTimer* timer = nullptr;
+  return timer;
+}
+
+#endif /* LOADPROFILER_H */
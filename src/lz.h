@@ -0,0 +1,124 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+/*
+ * small lz77 byte codec for the asset pack, the same block layout as lz4:
+ *
+ *   token         literal count << 4 | (match length - 4), 15 in either means more follows
+ *   [count]       255 bytes then the rest, for a literal count of 15 or more
+ *   literals
+ *   offset        2 bytes little endian, how far back the match starts
+ *   [length]      same as count, for a match length of 19 or more
+ *
+ * the last sequence is literals only. compression is one greedy pass with a hash of the
+ * next 4 bytes, fast rather than tight, decompression is a copy loop
+ */
+
+#define LZ_MIN_MATCH     4
+#define LZ_HASH_BITS     14
+#define LZ_MAX_OFFSET    65535
+// the end of the input is always literals, so matches stop this far short of it
+#define LZ_LAST_LITERALS 5
+
+static void lzWriteLength(std::vector<uint8_t>& out, size_t length) {
+  while (length >= 255) {
+    out.push_back(255);
+    length -= 255;
+  }
+  out.push_back((uint8_t)length);
+}
+
+static void lzWriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) {
+  size_t extra = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+  out.push_back((uint8_t)(std::min<size_t>(literalCount, 15) << 4 | std::min<size_t>(extra, 15)));
+  if (literalCount >= 15) lzWriteLength(out, literalCount - 15);
+  out.insert(out.end(), literals, literals + literalCount);
+
+  if (!matchLength) return;
+  out.push_back((uint8_t)(offset & 0xFF));
+  out.push_back((uint8_t)(offset >> 8));
+  if (extra >= 15) lzWriteLength(out, extra - 15);
+}
+
+std::vector<uint8_t> lzCompress(const uint8_t* in, size_t size) {
+  std::vector<uint8_t> out;
+  out.reserve(size + size / 255 + 16);
+
+  size_t anchor = 0;
+  if (size >= LZ_MIN_MATCH + LZ_LAST_LITERALS) {
+    std::vector<int64_t> table(1 << LZ_HASH_BITS, -1);
+    size_t limit = size - LZ_LAST_LITERALS;
+    size_t i = 0;
+
+    while (i + LZ_MIN_MATCH <= limit) {
+      uint32_t sequence;
+      std::memcpy(&sequence, in + i, sizeof(sequence));
+      uint32_t slot = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+      int64_t candidate = table[slot];
+      table[slot] = i;
+
+      if (candidate < 0 || i - candidate > LZ_MAX_OFFSET || std::memcmp(in + candidate, in + i, LZ_MIN_MATCH) != 0) {
+        i++;
+        continue;
+      }
+
+      size_t length = LZ_MIN_MATCH;
+      while (i + length < limit && in[candidate + length] == in[i + length]) length++;
+      lzWriteSequence(out, in + anchor, i - anchor, i - candidate, length);
+      i += length;
+      anchor = i;
+    }
+  }
+
+  lzWriteSequence(out, in + anchor, size - anchor, 0, 0);
+  return out;
+}
+
+static bool lzReadLength(const uint8_t* in, size_t size, size_t& position, size_t& length) {
+  uint8_t byte;
+  do {
+    if (position >= size) return false;
+    byte = in[position++];
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// false if the input is corrupt or doesn't come out at exactly outSize bytes
+bool lzDecompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+  size_t ip = 0, op = 0;
+
+  while (ip < inSize) {
+    uint8_t token = in[ip++];
+
+    size_t literalCount = token >> 4;
+    if (literalCount == 15 && !lzReadLength(in, inSize, ip, literalCount)) return false;
+    if (ip + literalCount > inSize || op + literalCount > outSize) return false;
+    std::memcpy(out + op, in + ip, literalCount);
+    ip += literalCount;
+    op += literalCount;
+
+    // the last sequence has no match
+    if (ip == inSize) break;
+
+    if (ip + 2 > inSize) return false;
+    size_t offset = in[ip] | (size_t)in[ip + 1] << 8;
+    ip += 2;
+    size_t length = token & 15;
+    if (length == 15 && !lzReadLength(in, inSize, ip, length)) return false;
+    length += LZ_MIN_MATCH;
+    if (offset == 0 || offset > op || op + length > outSize) return false;
+
+    // byte by byte, a match can overlap what it's copying
+    for (size_t k = 0; k < length; k++, op++) out[op] = out[op - offset];
+  }
+  return op == outSize;
+}
+
+#endif /* LZ_H */
@@ -1,5 +1,7 @@
 #include <math.h>
 #include <iostream>
+#include <cstdlib>
+#include <random>
 
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
@@ -11,9 +13,17 @@
 #define STB_IMAGE_IMPLEMENTATION
 
 #include "shader.h"
+#include "uniformBuffer.h"
+#include "glState.h"
+#include "renderQueue.h"
 #include "model.h"
+#include "modelStreamer.h"
+#include "assetManager.h"
+#include "assetPack.h"
+#include "loadProfiler.h"
 #include "sprite.h"
 #include "entity/prop.h"
+#include "entity/instancedProp.h"
 #include "entity/light/directionalLight.h"
 #include "entity/light/pointLight.h"
 #include "entity/light/spotLight.h"
@@ -40,6 +50,8 @@ struct {
     float fov       = DEFAULT_FOV;
 } camera;
 
+int viewportHeight = 600;
+
 bool _w = false, _a = false, _s = false, _d = false;
 bool flashlight = false;
 
@@ -47,6 +59,7 @@ bool flashlight = false;
 // GLFW can do this for us
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+    viewportHeight = height;
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -139,6 +152,11 @@ void playerMovement() {
 }
 
 int main() {
+    LoadProfiler::shared().begin();
+
+    // everything after this comes out of the pack if there is one (`make pack`), loose files otherwise
+    AssetPack::shared().open();
+
     glfwInit(); // initialise GLFW
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); // configure with `glfwWindowHint`
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -161,13 +179,39 @@ int main() {
         std::cout << "Failed to initialise GLAD" << std::endl;
         return -1;
     }
+    loadGLExtensions((GLADloadproc)glfwGetProcAddress);
 
     glViewport(0, 0, 800, 600);
-    glEnable(GL_DEPTH_TEST);
-
-    Prop asteroid1 = Prop(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), "assets/asteroid1.obj");
-    Prop asteroid2 = Prop(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), "assets/asteroid2.obj");
-    Prop asteroid3 = Prop(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), "assets/asteroid3.obj");
+    GLState::shared().setDepthTest(true);
+
+    ModelStreamer streamer;
+    AssetManager& assets = AssetManager::shared();
+    assets.setStreamer(&streamer);
+    bool streaming = true;
+
+    Prop asteroid1 = Prop(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), assets.model("assets/asteroid1.obj", VERTEX_LAYOUT_PACKED));
+    Prop asteroid2 = Prop(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), assets.model("assets/asteroid2.obj", VERTEX_LAYOUT_PACKED));
+    Prop asteroid3 = Prop(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), assets.model("assets/asteroid3.obj", VERTEX_LAYOUT_PACKED));
+
+    // a ring of asteroids around the middle, all one instanced draw per lod. off unless
+    // ASTEROID_COUNT asks for some, it's a stress test rather than part of the scene
+    InstancedProp asteroidField(assets.model("assets/asteroid1.obj", VERTEX_LAYOUT_PACKED));
+    {
+      const char* countVariable = std::getenv("ASTEROID_COUNT");
+      uint asteroidCount = countVariable ? std::strtoul(countVariable, nullptr, 10) : 0;
+      std::mt19937 random(1);
+      std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+      asteroidField.reserve(asteroidCount);
+      for (uint i = 0; i < asteroidCount; i++) {
+        float angle  = unit(random) * 2.0f * (float)M_PI;
+        float radius = 30.0f + unit(random) * 30.0f;
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(sin(angle) * radius, (unit(random) - 0.5f) * 6.0f, cos(angle) * radius));
+        transform = glm::rotate(transform, unit(random) * 2.0f * (float)M_PI, glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.01f)));
+        transform = glm::scale(transform, glm::vec3(0.05f + unit(random) * 0.25f));
+        float grey = 0.6f + unit(random) * 0.4f;
+        asteroidField.add(transform, glm::vec4(grey, grey * 0.95f, grey * 0.9f, 1.0f));
+      }
+    }
 
     //Model backpack = Model("assets/asteroid.obj");
 
@@ -212,7 +256,10 @@ int main() {
         glm::vec3(1.0f, 1.0f, 1.0f),       // White
     };
 
-    Shader litShader   = Shader("src/shaders/default.vert", "src/shaders/phong/litobject.frag");
+    std::shared_ptr<Shader> litShaderAsset = assets.shader("src/shaders/default.vert", "src/shaders/phong/litobject.frag");
+    Shader& litShader  = *litShaderAsset;
+    std::shared_ptr<Shader> instancedShaderAsset = assets.shader("src/shaders/instanced.vert", "src/shaders/phong/litobject.frag");
+    Shader& instancedShader = *instancedShaderAsset;
     //Shader lightShader = Shader("src/shaders/default.vert", "src/shaders/phong/light.frag");
     //Shader spriteShader = Shader("src/shaders/sprite/sprite.vert", "src/shaders/sprite/sprite.frag");
 
@@ -228,11 +275,45 @@ int main() {
     std::vector<SpotLight> spotLights;
     SpotLight flashlightLight = SpotLight(camera.pos, camera.front, 5.0f, 35.0f, glm::vec3(0.0f), glm::vec3(1.0f), glm::vec3(1.0));
 
-    glEnable(GL_CULL_FACE);
+    // camera and lights go to every shader through these, one upload each a frame
+    UniformBuffer<FrameData> frameBuffer(FRAME_DATA_BINDING);
+    UniformBuffer<LightData> lightBuffer(LIGHT_DATA_BINDING);
+
+    // everything drawn goes through here, see RenderQueue
+    RenderQueue renderQueue;
+
+    // named once here, the loop only indexes them
+    const Uniform modelUniform("model"), shininessUniform("material.shininess");
+
+    GLState::shared().setCullFace(true);
     glClearColor(0.16f, 0.09f, 0.21f, 1.0f);
     while(!glfwWindowShouldClose(window)) { 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // uniform uploads and binds counted per frame, the last frame's kept for the report
+        UniformUploadStats uniformStats = Shader::uploadStats();
+        Shader::uploadStats().reset();
+        GLStateStats stateStats = GLState::shared().stats();
+        GLState::shared().stats().reset();
+
+        streamer.update();
+        if (streaming && streamer.pending() == 0) {
+            streaming = false;
+            TextureCache::shared().report();
+            std::cout << "INFO::UNIFORMS::LAST_FRAME " << uniformStats.issued << " uploaded, "
+                      << uniformStats.skipped << " skipped as unchanged" << std::endl;
+            std::cout << "INFO::GLSTATE::LAST_FRAME " << stateStats.binds() << " binds (" << stateStats.programBinds << " program, "
+                      << stateStats.vertexArrayBinds << " vertex array, " << stateStats.textureBinds << " texture, "
+                      << stateStats.bufferBinds << " buffer, " << stateStats.capabilityChanges << " enable), "
+                      << stateStats.skipped << " skipped as already bound" << std::endl;
+
+            // LOAD_PROFILE_JSON=profile.json writes the breakdown out for CI as well
+            LoadProfiler::shared().finish();
+            LoadProfiler::shared().report();
+            if (const char* profilePath = std::getenv("LOAD_PROFILE_JSON"))
+                LoadProfiler::shared().writeJson(profilePath);
+        }
+
         glm::mat4 view = glm::lookAt(camera.pos, camera.pos + camera.front, CAMERA_UP);
 
         glm::mat4 model = glm::mat4(1.0f);
@@ -240,53 +321,77 @@ int main() {
         model = glm::rotate(model, (float)glfwGetTime(), glm::vec3(1.0f, 0.0f, 1.0f));
 
         glm::mat4 projection = glm::perspective(glm::radians(camera.fov), (float)(16/9), 0.1f, 100.0f);
+        View frame = { view, projection, camera.pos, (float)viewportHeight };
 
-        litShader.use();
-        litShader.setMat4("view",       view);
-        litShader.setMat4("model",      model);
-        litShader.setMat4("projection", projection);
-        litShader.setVec3("viewPos",    camera.pos);
+        frameBuffer.data.view       = view;
+        frameBuffer.data.projection = projection;
+        frameBuffer.data.viewPos    = camera.pos;
+        frameBuffer.upload();
 
-        dirLight.addToShader(litShader);
+        // only lights that changed are written, and the block only goes up if one did
+        LightData& lights = lightBuffer.data;
+        bool lightsChanged = dirLight.pack(lights.dirLight);
 
-        litShader.setInt("spotLightAmount", spotLights.size());
-        for (uint i = 0; i < spotLights.size(); i++)
-          spotLights[i].addToShader(litShader);
+        // a light that's moved to another slot has to be written even if it's clean
+        int spotLightAmount = std::min((int)spotLights.size(), MAX_SPOT_LIGHTS);
+        bool spotLightsResized = spotLightAmount != lights.spotLightAmount;
+        lights.spotLightAmount = spotLightAmount;
+        for (int i = 0; i < spotLightAmount; i++)
+          lightsChanged |= spotLights[i].pack(lights.spotLights[i], spotLightsResized);
 
-        litShader.setInt("usingFlashlight", flashlight);
         flashlightLight.setPosition(camera.pos);
         flashlightLight.setDirection(camera.front);
-        if (flashlight) flashlightLight.addToShader(litShader, "flashlight");
+        lightsChanged |= lights.usingFlashlight != (int)flashlight;
+        lights.usingFlashlight = flashlight;
+        if (flashlight) lightsChanged |= flashlightLight.pack(lights.flashlight);
+
+        int pointLightAmount = std::min((int)pointLights.size(), MAX_POINT_LIGHTS);
+        bool pointLightsResized = pointLightAmount != lights.pointLightAmount;
+        lights.pointLightAmount = pointLightAmount;
+        for (int i = 0; i < pointLightAmount; i++)
+          lightsChanged |= pointLights[i].pack(lights.pointLights[i], pointLightsResized);
 
-        litShader.setInt("pointLightAmount", (int)pointLights.size());
-        for (uint i = 0; i < pointLights.size(); i++)
-          pointLights[i].addToShader(litShader, i);
+        if (lightsChanged || spotLightsResized || pointLightsResized) lightBuffer.upload();
 
-        litShader.setFloat("material.shininess", 32);
+        litShader.use();
+        litShader.setMat4(modelUniform, model);
+        litShader.setFloat(shininessUniform, 32);
+        instancedShader.use();
+        instancedShader.setFloat(shininessUniform, 32);
 
         // ---------- ASTEROIDS
 
         asteroid1.setRotationX(glfwGetTime() / 100);
         asteroid1.setRotationY(glfwGetTime() / 64);
         asteroid1.setPosition(sin(glfwGetTime() / 190) * 24, 0.0f, cos(glfwGetTime() / 174) * 20);
-        asteroid1.draw(litShader);
+        asteroid1.submit(renderQueue, litShader, frame);
 
         asteroid2.setRotationX(glfwGetTime() / 92);
         asteroid2.setRotationY(glfwGetTime() / 54);
         asteroid2.setRotationZ(sin(glfwGetTime()/64) / 2);
         asteroid2.setPosition(sin(glfwGetTime() / 95) * 3.4f, sin(glfwGetTime() / 75) * 3.4f, -5.0f);
-        asteroid2.draw(litShader);
+        asteroid2.submit(renderQueue, litShader, frame);
 
         asteroid3.setRotationX(glfwGetTime() / 100);
         asteroid3.setRotationY(glfwGetTime() / 64);
         asteroid3.setPosition(-sin(glfwGetTime() / 140) * 18, 0.0f, -cos(glfwGetTime() / 134) * 12);
-        asteroid3.draw(litShader);
+        asteroid3.submit(renderQueue, litShader, frame);
+
+        asteroidField.submit(renderQueue, instancedShader, frame);
+
+        // sorted by state and depth, then drawn
+        renderQueue.flush(frame);
+
+        // uploads toward the texture detail the props asked for while drawing
+        TextureStreamer::shared().update();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
         playerMovement();
     }
 
-    glfwTerminate();
+    // props, sprites and shaders free their gl objects as they go out of scope, which is
+    // after this returns, so the context has to outlive main
+    std::atexit(glfwTerminate);
     return 0;
 }
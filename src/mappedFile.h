@@ -0,0 +1,164 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "loadProfiler.h"
+
+class MappedFile;
+
+// somewhere other than the filesystem that files can come from (see AssetPack), asked
+// before the filesystem by MappedFile, fileSize and fileModifiedTime
+class FileSource {
+  public:
+    virtual ~FileSource() {}
+    virtual bool open(const std::string& path, MappedFile& file) = 0;
+    // false if it doesn't have the file
+    virtual bool stat(const std::string& path, int64_t& size, int64_t& modified) = 0;
+};
+
+// null unless a pack is open
+FileSource*& fileSource() {
+  static FileSource* source = nullptr;
+  return source;
+}
+
+// read-only view of a whole file, backed by mmap so the pages come straight
+// from the page cache and nothing is copied until someone touches them
+class MappedFile {
+  public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    // for FileSources: a range of someone else's memory that outlives this, or bytes it takes over
+    void openView(const unsigned char* data, size_t size);
+    void openBytes(std::vector<unsigned char>&& bytes);
+
+    bool isOpen() const;
+    const unsigned char* data() const;
+    size_t size() const;
+
+  private:
+    void*  _data;
+    size_t _size;
+    // whether _data is our own mapping to unmap
+    bool   _mapped;
+    std::vector<unsigned char> _bytes;
+
+    bool openFile(const std::string& path);
+};
+
+MappedFile::MappedFile()
+  : _data(nullptr), _size(0), _mapped(false) {
+}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+// counted as read by whatever asset is loading, the pages mostly get touched straight after
+bool MappedFile::open(const std::string& path) {
+  const std::string& asset = LoadProfiler::currentAsset();
+  LoadTimer timer(LOAD_STAGE_READ, asset.empty() ? path : asset);
+  if (!openFile(path)) return false;
+
+  LoadProfiler::shared().addRead(asset.empty() ? path : asset, _size);
+  return true;
+}
+
+bool MappedFile::openFile(const std::string& path) {
+  close();
+  if (fileSource() && fileSource()->open(path, *this)) return true;
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) return false;
+
+  _data = data;
+  _size = st.st_size;
+  _mapped = true;
+  return true;
+}
+
+void MappedFile::openView(const unsigned char* data, size_t size) {
+  close();
+  _data = (void*)data;
+  _size = size;
+}
+
+void MappedFile::openBytes(std::vector<unsigned char>&& bytes) {
+  close();
+  _bytes = std::move(bytes);
+  _data = _bytes.data();
+  _size = _bytes.size();
+}
+
+void MappedFile::close() {
+  if (_mapped) munmap(_data, _size);
+  _data = nullptr;
+  _size = 0;
+  _mapped = false;
+  _bytes = std::vector<unsigned char>();
+}
+
+bool MappedFile::isOpen() const {
+  return _data != nullptr;
+}
+
+const unsigned char* MappedFile::data() const {
+  return (const unsigned char*)_data;
+}
+
+size_t MappedFile::size() const {
+  return _size;
+}
+
+// modification time in nanoseconds, 0 if the file doesn't exist
+int64_t fileModifiedTime(const std::string& path) {
+  int64_t size, modified;
+  if (fileSource() && fileSource()->stat(path, size, modified)) return modified;
+
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return 0;
+  return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+int64_t fileSize(const std::string& path) {
+  int64_t size, modified;
+  if (fileSource() && fileSource()->stat(path, size, modified)) return size;
+
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return -1;
+  return st.st_size;
+}
+
+// falls back to the path as given if the filesystem can't make sense of it
+std::string canonicalPath(const std::string& path) {
+  std::error_code error;
+  std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+  return error ? path : canonical.string();
+}
+
+#endif /* MAPPEDFILE_H */
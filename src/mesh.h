@@ -6,124 +6,562 @@
 #include "stb_image.h"
 #endif
 #include <vector>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include "shader.h"
+#include "glState.h"
+#include "image.h"
+#include "meshlet.h"
+#include "bounds.h"
+#include "vertex.h"
+#include "geometryArena.h"
 
-struct Vertex {
-  glm::vec3 position;
-  glm::vec3 normal;
-  glm::vec2 texCoords;
+// packed meshes only stay float if quantising them would move a vertex further than this
+#define PACKED_POSITION_TOLERANCE 0.001f
+
+// turns the normalised packed attributes back into model space, `offset + scale * value`.
+// identity for float meshes so default.vert can treat both the same
+struct VertexQuantization {
+  glm::vec3 positionScale  = glm::vec3(1.0f);
+  glm::vec3 positionOffset = glm::vec3(0.0f);
+  glm::vec2 texCoordScale  = glm::vec2(1.0f);
+  glm::vec2 texCoordOffset = glm::vec2(0.0f);
 };
 
+// owns a gl texture and deletes it with itself, so it can only be moved. share one
+// through a shared_ptr (see TextureCache)
 struct Texture {
-  uint id;
+  uint id = 0;
+  std::string path;
+
+  Texture() {}
+  explicit Texture(uint id, std::string path = "") : id(id), path(path) {}
+  ~Texture();
+
+  Texture(const Texture&) = delete;
+  Texture& operator=(const Texture&) = delete;
+  Texture(Texture&& other) noexcept;
+  Texture& operator=(Texture&& other) noexcept;
+};
+
+Texture::~Texture() {
+  if (id) GLState::shared().deleteTexture(id);
+}
+
+Texture::Texture(Texture&& other) noexcept
+  : id(other.id), path(std::move(other.path)) {
+  other.id = 0;
+}
+
+Texture& Texture::operator=(Texture&& other) noexcept {
+  if (this != &other) {
+    if (id) GLState::shared().deleteTexture(id);
+    id   = other.id;
+    path = std::move(other.path);
+    other.id = 0;
+  }
+  return *this;
+}
+
+// a texture as one mesh samples it, the type picks the material uniform it's bound to
+struct MeshTexture {
+  std::shared_ptr<Texture> texture;
+  std::string type;
+};
+
+// a texture a mesh wants but that hasn't been loaded yet, path is relative to the model
+struct TextureRef {
   std::string type;
   std::string path;
 };
 
+// one level of detail, a range of the mesh's index buffer drawn with the same vertices.
+// error is how far (in model space) it strays from the full mesh
+struct MeshLod {
+  uint  firstIndex;
+  uint  indexCount;
+  float error;
+};
+
+// indices are relative to the mesh's first vertex, so 16 bits do up to 65536 vertices
+static inline uint meshIndexSize(uint vertexCount) {
+  return vertexCount <= 65536 ? sizeof(uint16_t) : sizeof(uint);
+}
+
+// cpu side of a mesh, safe to build off the gl thread
+struct MeshData {
+  // what loading and processing work on, empty when the mesh came from a mesh cache
+  std::vector<Vertex>     vertices;
+  std::vector<uint>       indices;
+  std::vector<TextureRef> textures;
+
+  // set when the mesh came from a mesh cache: the geometry exactly as it's uploaded, see upload*()
+  const void* mappedVertices    = nullptr;
+  const void* mappedIndices     = nullptr;
+  uint        mappedVertexCount = 0;
+  uint        mappedIndexCount  = 0;
+  // bytes per uploaded index, meshIndexSize() once prepareUpload() ran
+  uint        indexSize         = sizeof(uint);
+
+  glm::vec3 boundsMin = glm::vec3(0.0f);
+  glm::vec3 boundsMax = glm::vec3(0.0f);
+  BoundingSphere boundingSphere;
+
+  // filled by pack() for meshes that get uploaded with VERTEX_LAYOUT_PACKED
+  VertexLayout              layout = VERTEX_LAYOUT_FLOAT;
+  std::vector<PackedVertex> packedVertices;
+  VertexQuantization        quantization;
+  // the 16 bit copy of indices prepareUpload() makes when they fit
+  std::vector<uint16_t>     shortIndices;
+
+  // ranges of indices that get culled on their own, empty for small meshes
+  std::vector<Meshlet> meshlets;
+  // lods[0] is the full mesh and the rest follow it in indices, empty if the mesh wasn't simplified
+  std::vector<MeshLod> lods;
+
+  const Vertex* vertexData() const { return vertices.data(); }
+  uint vertexCount() const         { return vertices.size(); }
+  const uint* indexData() const    { return indices.data(); }
+  uint indexCount() const          { return indices.size(); }
+
+  // vertices in `layout` and indices indexSize bytes each, what goes into the GeometryArena
+  const void* uploadVertices() const;
+  uint uploadVertexCount() const { return mappedVertices ? mappedVertexCount : vertices.size(); }
+  const void* uploadIndices() const;
+  uint uploadIndexCount() const  { return mappedIndices  ? mappedIndexCount  : indices.size(); }
+
+  // the aabb and the bounding sphere
+  void computeBounds();
+  // quantises into packedVertices, stays float if the bounds are too big for 16 bits; needs computeBounds first
+  void pack();
+  // packs if asked to and fills in the upload arrays, once processing is done
+  void prepareUpload(VertexLayout requested);
+};
+
+void MeshData::computeBounds() {
+  const float* positions = (const float*)vertexData();
+  uint count = vertexCount();
+  if (count == 0) return;
+
+  const uint stride = sizeof(Vertex) / sizeof(float);
+  positionBounds(positions, count, stride, boundsMin, boundsMax);
+
+  // long thin meshes can come out tighter around the box
+  boundingSphere = ritterSphere(positions, count, stride);
+  BoundingSphere box = boxSphere(boundsMin, boundsMax);
+  if (box.radius < boundingSphere.radius) boundingSphere = box;
+}
+
+static int16_t packSnorm16(float value) {
+  return (int16_t)std::lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static uint16_t packUnorm16(float value) {
+  return (uint16_t)std::lround(glm::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+// octahedral mapping, folds the unit sphere onto a square so a normal fits in two numbers
+static glm::vec2 octEncode(glm::vec3 n) {
+  n /= std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+  glm::vec2 e(n.x, n.y);
+  if (n.z < 0.0f) {
+    e.x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+    e.y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return e;
+}
+
+void MeshData::pack() {
+  const Vertex* data = vertexData();
+  uint count = vertexCount();
+
+  glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+  float largest = std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+  if (count == 0 || largest / 32767.0f > PACKED_POSITION_TOLERANCE) {
+    layout = VERTEX_LAYOUT_FLOAT;
+    return;
+  }
+
+  glm::vec2 uvMin = data[0].texCoords, uvMax = data[0].texCoords;
+  for (uint i = 1; i < count; i++) {
+    uvMin = glm::vec2(std::min(uvMin.x, data[i].texCoords.x), std::min(uvMin.y, data[i].texCoords.y));
+    uvMax = glm::vec2(std::max(uvMax.x, data[i].texCoords.x), std::max(uvMax.y, data[i].texCoords.y));
+  }
+
+  // a flat axis would divide by zero, any scale works for it
+  for (int k = 0; k < 3; k++) if (halfExtent[k] == 0.0f) halfExtent[k] = 1.0f;
+  glm::vec2 uvExtent = uvMax - uvMin;
+  for (int k = 0; k < 2; k++) if (uvExtent[k] == 0.0f) uvExtent[k] = 1.0f;
+
+  quantization.positionScale  = halfExtent;
+  quantization.positionOffset = (boundsMin + boundsMax) * 0.5f;
+  quantization.texCoordScale  = uvExtent;
+  quantization.texCoordOffset = uvMin;
+
+  packedVertices.resize(count);
+  for (uint i = 0; i < count; i++) {
+    PackedVertex& packed = packedVertices[i];
+    glm::vec3 position = (data[i].position - quantization.positionOffset) / halfExtent;
+    glm::vec2 uv       = (data[i].texCoords - uvMin) / uvExtent;
+
+    glm::vec3 normal = data[i].normal;
+    glm::vec2 octahedral = (normal == glm::vec3(0.0f)) ? glm::vec2(0.0f) : octEncode(normal);
+
+    packed.position[0]  = packSnorm16(position.x);
+    packed.position[1]  = packSnorm16(position.y);
+    packed.position[2]  = packSnorm16(position.z);
+    packed.position[3]  = 0;
+    packed.normal[0]    = packSnorm16(octahedral.x);
+    packed.normal[1]    = packSnorm16(octahedral.y);
+    packed.texCoords[0] = packUnorm16(uv.x);
+    packed.texCoords[1] = packUnorm16(uv.y);
+  }
+
+  layout = VERTEX_LAYOUT_PACKED;
+}
+
+// a run of instances in an instance buffer, all drawn at one lod
+struct InstanceRange {
+  size_t first;
+  uint   count;
+  uint   lod;
+};
+
+void MeshData::prepareUpload(VertexLayout requested) {
+  if (requested == VERTEX_LAYOUT_PACKED) pack();
+
+  indexSize = meshIndexSize(vertices.size());
+  if (indexSize == sizeof(uint16_t)) shortIndices.assign(indices.begin(), indices.end());
+}
+
+const void* MeshData::uploadVertices() const {
+  if (mappedVertices) return mappedVertices;
+  return layout == VERTEX_LAYOUT_PACKED ? (const void*)packedVertices.data() : (const void*)vertices.data();
+}
+
+const void* MeshData::uploadIndices() const {
+  if (mappedIndices) return mappedIndices;
+  return indexSize == sizeof(uint16_t) ? (const void*)shortIndices.data() : (const void*)indices.data();
+}
+
+// owns its piece of its layout's GeometryArena and gives it back with itself, so it can
+// only be moved. the cpu copies of the geometry are dropped once it's uploaded unless
+// asked to keep them
 class Mesh {
   public:
-    std::vector<Vertex>  vertices;
-    std::vector<uint>    indices;
-    std::vector<Texture> textures;
+    // only filled when the mesh was made with keepCpuCopy
+    std::vector<Vertex>      vertices;
+    std::vector<uint>        indices;
+    std::vector<MeshTexture> textures;
+
+    Mesh(std::vector<Vertex> vertices, std::vector<uint> indices, std::vector<MeshTexture> textures, bool keepCpuCopy = false);
+    // uploads straight from the given memory (e.g. a mapped cache) without keeping a cpu copy
+    Mesh(const Vertex* vertices, uint vertexCount, const uint* indices, uint indexCount, std::vector<MeshTexture> textures);
+    Mesh(const MeshData& data, std::vector<MeshTexture> textures);
+    ~Mesh();
 
-    Mesh();
-    Mesh(std::vector<Vertex> vertices, std::vector<uint> indices, std::vector<Texture> textures);
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
 
     void draw(Shader &shader);
+    // skips meshlets that are off screen or facing away, frustum and camera in model space.
+    // lods past the mesh's last draw the last one, only the full mesh has meshlets
+    void draw(Shader &shader, const Frustum& frustum, glm::vec3 camera, uint lod = 0);
+    // every range in one multiDraw, InstanceData read from buffer. that's one gl call with
+    // base instance, one per range without
+    void drawInstanced(Shader &shader, uint buffer, const std::vector<InstanceRange>& ranges);
+
+    // gl names standing for the mesh and its textures in render queue sort keys. the
+    // vertex array is the arena's, shared by every mesh of the layout
+    uint vertexArray() const { return arena ? arena->vertexArray() : 0; }
+    uint firstTexture() const { return textures.empty() || !textures[0].texture ? 0 : textures[0].texture->id; }
 
   private:
-    uint VAO, VBO, EBO;
+    GeometryArena*     arena = nullptr;
+    GeometryAllocation geometry;
+    uint indexCount = 0;
+    // GL_UNSIGNED_SHORT whenever the vertex count allows it
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    VertexLayout       layout = VERTEX_LAYOUT_FLOAT;
+    VertexQuantization quantization;
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshLod> lods;
+    // material.texture_diffuse1, ... per texture, named once rather than every bind
+    std::vector<Uniform> samplers;
 
-    void setupMesh();
+    void bind(Shader &shader);
+    static std::vector<Uniform> samplerUniforms(const std::vector<MeshTexture>& textures);
+    uint indexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint); }
+    // the indices from first (counted from the mesh's own start) as a multi draw command
+    DrawElementsIndirectCommand command(uint first, uint count, uint instances = 1, uint baseInstance = 0) const;
+    // narrows the indices to 16 bits when they fit, then upload()s
+    void setupMesh(const void* vertices, uint vertexCount, const uint* indices, uint indexCount);
+    void upload(const void* vertices, uint vertexCount, const void* indices, uint indexCount, uint indexSize);
+    void release();
 };
 
-Mesh::Mesh() {
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<uint> indices, std::vector<MeshTexture> textures, bool keepCpuCopy)
+  : textures(std::move(textures)) {
+  setupMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+
+  if (keepCpuCopy) {
+    this->vertices = std::move(vertices);
+    this->indices  = std::move(indices);
+  }
 }
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<uint> indices, std::vector<Texture> textures) {
-  this->vertices = vertices;
-  this->indices  = indices;
-  this->textures = textures;
+Mesh::Mesh(const Vertex* vertices, uint vertexCount, const uint* indices, uint indexCount, std::vector<MeshTexture> textures)
+  : textures(std::move(textures)) {
+  setupMesh(vertices, vertexCount, indices, indexCount);
+}
 
-  // setup mesh
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-  glGenBuffers(1, &EBO);
+Mesh::Mesh(const MeshData& data, std::vector<MeshTexture> textures)
+  : textures(std::move(textures)), layout(data.layout), quantization(data.quantization),
+    meshlets(data.meshlets), lods(data.lods) {
+  upload(data.uploadVertices(), data.uploadVertexCount(), data.uploadIndices(), data.uploadIndexCount(), data.indexSize);
+}
 
-  glBindVertexArray(VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+Mesh::~Mesh() {
+  release();
+}
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint), &indices[0], GL_STATIC_DRAW);
+Mesh::Mesh(Mesh&& other) noexcept {
+  *this = std::move(other);
+}
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-  glEnableVertexAttribArray(0);
+Mesh& Mesh::operator=(Mesh&& other) noexcept {
+  if (this == &other) return *this;
+  release();
 
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-  glEnableVertexAttribArray(1);
+  vertices     = std::move(other.vertices);
+  indices      = std::move(other.indices);
+  textures     = std::move(other.textures);
+  arena        = other.arena;
+  geometry     = other.geometry;
+  indexCount   = other.indexCount;
+  indexType    = other.indexType;
+  layout       = other.layout;
+  quantization = other.quantization;
+  meshlets     = std::move(other.meshlets);
+  lods         = std::move(other.lods);
+  samplers     = std::move(other.samplers);
 
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-  glEnableVertexAttribArray(2);
+  // the moved from mesh is empty and has nothing left to give back
+  other.arena = nullptr;
+  other.indexCount = 0;
+  return *this;
+}
 
-  glBindVertexArray(0);
+void Mesh::setupMesh(const void* vertices, uint vertexCount, const uint* indices, uint indexCount) {
+  if (meshIndexSize(vertexCount) == sizeof(uint)) {
+    upload(vertices, vertexCount, indices, indexCount, sizeof(uint));
+    return;
+  }
+  std::vector<uint16_t> shortIndices(indices, indices + indexCount);
+  upload(vertices, vertexCount, shortIndices.data(), indexCount, sizeof(uint16_t));
 }
 
-void Mesh::draw(Shader &shader) {
+void Mesh::upload(const void* vertices, uint vertexCount, const void* indices, uint indexCount, uint indexSize) {
+  LoadTimer timer(LOAD_STAGE_MESH_UPLOAD);
+  this->indexCount = indexCount;
+  indexType = indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  samplers = samplerUniforms(textures);
+
+  uint stride = layout == VERTEX_LAYOUT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+  LoadProfiler::shared().addUpload(LoadProfiler::currentAsset(), (size_t)vertexCount * stride + (size_t)indexCount * indexSize);
+
+  arena    = &GeometryArena::shared(layout);
+  geometry = arena->allocate(vertices, vertexCount, indices, (size_t)indexCount * indexSize);
+}
+
+void Mesh::release() {
+  if (arena) arena->free(geometry);
+  arena = nullptr;
+}
+
+std::vector<Uniform> Mesh::samplerUniforms(const std::vector<MeshTexture>& textures) {
   uint diffuseAmount  = 1;
   uint specularAmount = 1;
 
-  for (uint i = 0; i < textures.size(); i++) {
-    glActiveTexture(GL_TEXTURE0 + i);
-
+  std::vector<Uniform> samplers;
+  samplers.reserve(textures.size());
+  for (const MeshTexture& texture : textures) {
     std::string number;
-    std::string name = textures[i].type;
+    const std::string& name = texture.type;
     if (name == "texture_diffuse") {
       number = std::to_string(diffuseAmount++);
     } else if (name == "texture_specular") {
       number = std::to_string(specularAmount++);
     }
+    samplers.emplace_back("material." + name + number);
+  }
+  return samplers;
+}
+
+void Mesh::bind(Shader &shader) {
+  static const Uniform packedVertices("packedVertices"), positionScale("positionScale"),
+      positionOffset("positionOffset"), texCoordScale("texCoordScale"), texCoordOffset("texCoordOffset");
 
-    shader.setFloat(("material." + name + number).c_str(), i);
-    glBindTexture(GL_TEXTURE_2D, textures[i].id);
+  // textures, samplers and the vertex array already in place are skipped, the vertex
+  // array is left bound after the draw for the next mesh to find
+  for (uint i = 0; i < textures.size(); i++) {
+    // samplers take the unit as an int, glUniform1f on one is an error
+    shader.setInt(samplers[i], i);
+    GLState::shared().bindTexture(i, textures[i].texture ? textures[i].texture->id : 0);
   }
-  glActiveTexture(GL_TEXTURE0);
 
+  shader.setBool(packedVertices,  layout == VERTEX_LAYOUT_PACKED);
+  shader.setVec3(positionScale,   quantization.positionScale);
+  shader.setVec3(positionOffset,  quantization.positionOffset);
+  shader.setVec2(texCoordScale,   quantization.texCoordScale);
+  shader.setVec2(texCoordOffset,  quantization.texCoordOffset);
 
-  glBindVertexArray(VAO);
-  glDrawElements(GL_TRIANGLES,indices.size(), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
+  GLState::shared().bindVertexArray(vertexArray());
 }
 
-uint loadTexture(std::string file) {
-  stbi_set_flip_vertically_on_load(true);
+DrawElementsIndirectCommand Mesh::command(uint first, uint count, uint instances, uint baseInstance) const {
+  return { count, instances, (uint)(geometry.indexOffset / indexSize()) + first, (int)geometry.firstVertex, baseInstance };
+}
+
+void Mesh::draw(Shader &shader) {
+  bind(shader);
+  uint count = lods.empty() ? indexCount : lods[0].indexCount;
+  glDrawElementsBaseVertex(GL_TRIANGLES, count, indexType, (void*)(uintptr_t)geometry.indexOffset, geometry.firstVertex);
+}
+
+void Mesh::drawInstanced(Shader &shader, uint buffer, const std::vector<InstanceRange>& ranges) {
+  std::vector<DrawElementsIndirectCommand>& commands = arena->commandScratch();
+
+  for (const InstanceRange& range : ranges) {
+    if (range.count == 0) continue;
+    uint first = 0, count = indexCount;
+    if (!lods.empty()) {
+      const MeshLod& level = lods[std::min(range.lod, (uint)lods.size() - 1)];
+      first = level.firstIndex;
+      count = level.indexCount;
+    }
+    commands.push_back(command(first, count, range.count, range.first));
+  }
+  if (commands.empty()) return;
+
+  bind(shader);
+  arena->multiDraw(indexType, commands.data(), commands.size(), buffer);
+}
+
+void Mesh::draw(Shader &shader, const Frustum& frustum, glm::vec3 camera, uint lod) {
+  if (lod > 0 && !lods.empty()) {
+    const MeshLod& level = lods[std::min(lod, (uint)lods.size() - 1)];
+    bind(shader);
+    glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, indexType, (void*)(uintptr_t)(geometry.indexOffset + level.firstIndex * indexSize()), geometry.firstVertex);
+    return;
+  }
+
+  if (meshlets.empty()) {
+    draw(shader);
+    return;
+  }
+
+  // meshlets are back to back in the index buffer, so neighbouring visible ones merge into
+  // one command, and the commands all go out together
+  std::vector<DrawElementsIndirectCommand>& commands = arena->commandScratch();
+
+  uint first = 0, count = 0;
+  for (const Meshlet& meshlet : meshlets) {
+    if (!meshletVisible(meshlet, frustum, camera)) continue;
+
+    if (count > 0 && first + count == meshlet.firstIndex) {
+      count += meshlet.indexCount;
+      continue;
+    }
+    if (count > 0) commands.push_back(command(first, count));
+    first = meshlet.firstIndex;
+    count = meshlet.indexCount;
+  }
+  if (count > 0) commands.push_back(command(first, count));
+  if (commands.empty()) return;
+
+  bind(shader);
+  arena->multiDraw(indexType, commands.data(), commands.size());
+}
+
+// gl side of texture loading, must run on the thread that owns the context
+uint uploadTexture(const Image& image) {
+  LoadTimer timer(LOAD_STAGE_TEXTURE_UPLOAD, image.path);
+  size_t bytes = image.cooked ? image.cooked->dataSize() : image.mips ? image.mips->size() : (size_t)image.width * image.height * image.channels;
+  LoadProfiler::shared().addUpload(image.path, bytes);
+
   uint texture;
+  if (image.cooked)
+    return uploadKtx(*image.cooked);
+
+  if (image.mips && glCapabilities().directStateAccess) {
+    // made, filled and set up by name, nothing bound
+    const MipChain& mips = *image.mips;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureStorage2D(texture, mips.levels.size(), GL_RGBA8, mips.width, mips.height);
+    for (uint level = 0; level < mips.levels.size(); level++)
+      glTextureSubImage2D(texture, level, 0, 0, mips.levelWidth(level), mips.levelHeight(level), GL_RGBA, GL_UNSIGNED_BYTE, mips.levels[level].data());
+
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return texture;
+  }
+
   glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
+  GLState::shared().bindTexture(texture);
 
-  int width, height, nrChannels;
-  unsigned char* data = stbi_load((file).c_str(), &width, &height, &nrChannels, 0);
+  if (image.mips) {
+      // the whole chain was built on the loading thread, rows are rgba so 4 byte aligned
+      const MipChain& mips = *image.mips;
+      if (glCapabilities().textureStorage)
+        glTexStorage2D(GL_TEXTURE_2D, mips.levels.size(), GL_RGBA8, mips.width, mips.height);
+      for (uint level = 0; level < mips.levels.size(); level++) {
+        const void* pixels = mips.levels[level].data();
+        if (glCapabilities().textureStorage)
+          glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, mips.levelWidth(level), mips.levelHeight(level), GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        else
+          glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, mips.levelWidth(level), mips.levelHeight(level), 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+      }
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips.levels.size() - 1);
 
-  if (data) {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  } else if (image.data) {
       GLenum format;
-      if      (nrChannels == 1) format = GL_RED;
-      else if (nrChannels == 3) format = GL_RGB;
-      else if (nrChannels == 4) format = GL_RGBA;
+      if      (image.channels == 1) format = GL_RED;
+      else if (image.channels == 3) format = GL_RGB;
+      else if (image.channels == 4) format = GL_RGBA;
 
-      glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+      glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
       glGenerateMipmap(GL_TEXTURE_2D);
 
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
   } else {
-      std::cout << "Failed to load image '" << file << "'" << std::endl;
+      std::cout << "Failed to load image '" << image.path << "'" << std::endl;
   }
 
-  stbi_image_free(data);
+  return texture;
+}
+
+uint loadTexture(std::string file) {
+  Image image = loadImage(file);
+  uint texture = uploadTexture(image);
+  freeImage(image);
   return texture;
 };
 
@@ -0,0 +1,353 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <functional>
+#include <unistd.h>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "hash.h"
+#include "mappedFile.h"
+
+/*
+ * binary cache written next to a source model, one per vertex layout
+ * (asteroid1.obj -> asteroid1.obj.meshcache, asteroid1.obj.packed.meshcache)
+ *
+ *   MeshCacheHeader
+ *   MeshCacheEntry[meshCount]
+ *   MeshCacheDependency[dependencyCount]
+ *   texture references: per mesh, "type\0path\0" pairs, then the dependencies' paths
+ *   per mesh, 16-byte aligned: vertices[vertexCount], indices[indexCount], Meshlet[meshletCount], MeshLod[lodCount]
+ *
+ * the vertex and index arrays are stored exactly as they are uploaded (after
+ * optimizeMesh has welded and reordered them, pack() quantised them and the
+ * indices were narrowed to 16 bits where they fit), so a warm load maps the
+ * file and hands pointers into the mapping to the GeometryArena. entry.layout
+ * and entry.indexSize say which, a mesh asked to pack can stay float.
+ * indexCount covers every lod, they're stored one after the other
+ *
+ * the dependencies are the other files the import read, the material libraries the
+ * texture references came from. the cache is only good while they're unchanged too
+ */
+
+#define MESH_CACHE_MAGIC     "LOGLMESH"
+#define MESH_CACHE_VERSION   7
+#define MESH_CACHE_EXTENSION ".meshcache"
+
+struct MeshCacheHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t meshCount;
+  int64_t  sourceModified;
+  uint64_t sourceSize;
+  uint64_t sourceHash;
+  // the layout the cache was asked for
+  uint32_t layout;
+  uint32_t dependencyCount;
+};
+
+struct MeshCacheDependency {
+  // the same as the source's in the header, -1 and 0 for a file that wasn't there
+  int64_t  modified;
+  int64_t  size;
+  uint64_t hash;
+  uint32_t pathOffset;
+  uint32_t padding;
+};
+
+struct MeshCacheEntry {
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint32_t textureCount;
+  uint32_t textureOffset;
+  uint64_t meshletOffset;
+  uint32_t meshletCount;
+  uint64_t lodOffset;
+  uint32_t lodCount;
+  uint32_t layout;
+  uint32_t indexSize;
+  float    boundsMin[3];
+  float    boundsMax[3];
+  // center and radius
+  float    sphere[4];
+  float    positionScale[3];
+  float    positionOffset[3];
+  float    texCoordScale[2];
+  float    texCoordOffset[2];
+};
+
+static std::string meshCachePath(const std::string& sourcePath, VertexLayout layout) {
+  return sourcePath + (layout == VERTEX_LAYOUT_PACKED ? ".packed" : "") + MESH_CACHE_EXTENSION;
+}
+
+class MeshCache {
+  public:
+    MeshCache(std::string sourcePath, VertexLayout layout);
+
+    // maps the cache and checks it against the source, false if it has to be rebuilt.
+    // the meshes point into the mapping, so they're only valid while this is alive
+    bool open();
+
+    std::vector<MeshData> meshes;
+
+    // the meshes need prepareUpload(layout) first. dependencies are the other files the
+    // import read, see ModelData
+    static bool write(std::string sourcePath, VertexLayout layout, const std::vector<std::string>& dependencies,
+        const std::vector<MeshData>& meshes);
+
+  private:
+    std::string  _sourcePath;
+    std::string  _cachePath;
+    VertexLayout _layout;
+    MappedFile  _file;
+
+    bool validate(const MeshCacheHeader& header);
+    // path still has the size and content it had, modifiedOffset is where its mtime is in the cache
+    bool unchanged(const std::string& path, int64_t size, int64_t modified, uint64_t hash, size_t modifiedOffset);
+};
+
+MeshCache::MeshCache(std::string sourcePath, VertexLayout layout)
+  : _sourcePath(sourcePath), _cachePath(meshCachePath(sourcePath, layout)), _layout(layout) {
+}
+
+bool MeshCache::validate(const MeshCacheHeader& header) {
+  if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0) return false;
+  if (header.version != MESH_CACHE_VERSION) return false;
+  if (header.layout != (uint32_t)_layout) return false;
+
+  return unchanged(_sourcePath, header.sourceSize, header.sourceModified, header.sourceHash,
+      offsetof(MeshCacheHeader, sourceModified));
+}
+
+bool MeshCache::unchanged(const std::string& path, int64_t size, int64_t modified, uint64_t hash, size_t modifiedOffset) {
+  if (fileSize(path) != size) return false;
+
+  int64_t current = fileModifiedTime(path);
+  if (current == modified) return true;
+
+  // touched but maybe not changed (git checkout, copy), fall back to the content hash
+  if (hashFile(path) != hash) return false;
+
+  // remember the new mtime so the next start takes the fast path again
+  std::fstream out(_cachePath, std::ios::in | std::ios::out | std::ios::binary);
+  out.seekp(modifiedOffset);
+  out.write((const char*)&current, sizeof(current));
+  return true;
+}
+
+// count elements of elementSize at offset lie inside the mapping, and are aligned for them.
+// written so corrupt offsets and counts can't overflow their way past the check
+static bool meshCacheRange(uint64_t offset, uint64_t count, size_t elementSize, size_t size) {
+  if (offset > size || offset % 4 != 0) return false;
+  return count <= (size - offset) / elementSize;
+}
+
+// a "type\0path\0" string inside the mapping, moves str past it
+static bool meshCacheString(const char*& str, const char* end, std::string& out) {
+  const char* terminator = (const char*)std::memchr(str, '\0', end - str);
+  if (!terminator) return false;
+  out.assign(str, terminator);
+  str = terminator + 1;
+  return true;
+}
+
+bool MeshCache::open() {
+  if (!_file.open(_cachePath)) return false;
+
+  const unsigned char* data = _file.data();
+  size_t size = _file.size();
+
+  auto fail = [&](const char* reason) {
+    if (reason) std::cout << "ERROR::MESHCACHE::" << reason << " '" << _cachePath << "'" << std::endl;
+    meshes.clear();
+    _file.close();
+    return false;
+  };
+
+  if (size < sizeof(MeshCacheHeader)) return fail("TRUNCATED");
+  const MeshCacheHeader* header = (const MeshCacheHeader*)data;
+  // stale rather than broken, it just gets rebuilt
+  if (!validate(*header)) return fail(nullptr);
+
+  if (!meshCacheRange(sizeof(MeshCacheHeader), header->meshCount, sizeof(MeshCacheEntry), size)) return fail("TRUNCATED");
+  const MeshCacheEntry* entries = (const MeshCacheEntry*)(data + sizeof(MeshCacheHeader));
+  const char* end = (const char*)data + size;
+
+  uint64_t dependencyOffset = sizeof(MeshCacheHeader) + (uint64_t)header->meshCount * sizeof(MeshCacheEntry);
+  if (!meshCacheRange(dependencyOffset, header->dependencyCount, sizeof(MeshCacheDependency), size)) return fail("TRUNCATED");
+  const MeshCacheDependency* dependencies = (const MeshCacheDependency*)(data + dependencyOffset);
+  for (uint i = 0; i < header->dependencyCount; i++) {
+    const MeshCacheDependency& dependency = dependencies[i];
+    const char* str = (const char*)data + dependency.pathOffset;
+    std::string path;
+    if (dependency.pathOffset > size || !meshCacheString(str, end, path)) return fail("TRUNCATED");
+
+    size_t modifiedOffset = dependencyOffset + i * sizeof(MeshCacheDependency) + offsetof(MeshCacheDependency, modified);
+    if (!unchanged(path, dependency.size, dependency.modified, dependency.hash, modifiedOffset)) return fail(nullptr);
+  }
+
+  meshes.clear();
+  for (uint i = 0; i < header->meshCount; i++) {
+    const MeshCacheEntry& entry = entries[i];
+
+    if (entry.layout != VERTEX_LAYOUT_FLOAT && entry.layout != VERTEX_LAYOUT_PACKED) return fail("CORRUPT");
+    if (entry.indexSize != meshIndexSize(entry.vertexCount)) return fail("CORRUPT");
+    size_t stride = entry.layout == VERTEX_LAYOUT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+
+    if (!meshCacheRange(entry.vertexOffset,  entry.vertexCount,  stride,          size) ||
+        !meshCacheRange(entry.indexOffset,   entry.indexCount,   entry.indexSize, size) ||
+        !meshCacheRange(entry.meshletOffset, entry.meshletCount, sizeof(Meshlet), size) ||
+        !meshCacheRange(entry.lodOffset,     entry.lodCount,     sizeof(MeshLod), size) ||
+        entry.textureOffset > size)
+      return fail("TRUNCATED");
+
+    MeshData mesh;
+    mesh.layout            = (VertexLayout)entry.layout;
+    mesh.indexSize         = entry.indexSize;
+    mesh.mappedVertices    = data + entry.vertexOffset;
+    mesh.mappedVertexCount = entry.vertexCount;
+    mesh.mappedIndices     = data + entry.indexOffset;
+    mesh.mappedIndexCount  = entry.indexCount;
+    mesh.boundsMin = glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]);
+    mesh.boundsMax = glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]);
+    mesh.boundingSphere.center = glm::vec3(entry.sphere[0], entry.sphere[1], entry.sphere[2]);
+    mesh.boundingSphere.radius = entry.sphere[3];
+    mesh.quantization.positionScale  = glm::vec3(entry.positionScale[0], entry.positionScale[1], entry.positionScale[2]);
+    mesh.quantization.positionOffset = glm::vec3(entry.positionOffset[0], entry.positionOffset[1], entry.positionOffset[2]);
+    mesh.quantization.texCoordScale  = glm::vec2(entry.texCoordScale[0], entry.texCoordScale[1]);
+    mesh.quantization.texCoordOffset = glm::vec2(entry.texCoordOffset[0], entry.texCoordOffset[1]);
+
+    const Meshlet* meshlets = (const Meshlet*)(data + entry.meshletOffset);
+    mesh.meshlets.assign(meshlets, meshlets + entry.meshletCount);
+    const MeshLod* lods = (const MeshLod*)(data + entry.lodOffset);
+    mesh.lods.assign(lods, lods + entry.lodCount);
+
+    const char* str = (const char*)(data + entry.textureOffset);
+    for (uint t = 0; t < entry.textureCount; t++) {
+      TextureRef ref;
+      if (!meshCacheString(str, end, ref.type) || !meshCacheString(str, end, ref.path)) return fail("TRUNCATED");
+      mesh.textures.push_back(ref);
+    }
+
+    meshes.push_back(mesh);
+  }
+
+  return true;
+}
+
+static uint64_t alignOffset(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+bool MeshCache::write(std::string sourcePath, VertexLayout layout, const std::vector<std::string>& dependencies,
+    const std::vector<MeshData>& meshes) {
+  MeshCacheHeader header;
+  std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+  header.version        = MESH_CACHE_VERSION;
+  header.meshCount      = meshes.size();
+  header.sourceModified = fileModifiedTime(sourcePath);
+  header.sourceSize     = fileSize(sourcePath);
+  header.sourceHash     = hashFile(sourcePath);
+  header.layout          = layout;
+  header.dependencyCount = dependencies.size();
+
+  std::string strings;
+  std::vector<MeshCacheEntry> entries(meshes.size(), MeshCacheEntry());
+  std::vector<MeshCacheDependency> files(dependencies.size(), MeshCacheDependency());
+
+  uint64_t offset = sizeof(MeshCacheHeader) + meshes.size() * sizeof(MeshCacheEntry) + files.size() * sizeof(MeshCacheDependency);
+  for (uint i = 0; i < meshes.size(); i++) {
+    entries[i].textureCount  = meshes[i].textures.size();
+    entries[i].textureOffset = offset + strings.size();
+    for (const TextureRef& texture : meshes[i].textures) {
+      strings.append(texture.type); strings.push_back('\0');
+      strings.append(texture.path); strings.push_back('\0');
+    }
+  }
+  for (uint i = 0; i < files.size(); i++) {
+    files[i].modified   = fileModifiedTime(dependencies[i]);
+    files[i].size       = fileSize(dependencies[i]);
+    files[i].hash       = hashFile(dependencies[i]);
+    files[i].pathOffset = offset + strings.size();
+    strings.append(dependencies[i]); strings.push_back('\0');
+  }
+  offset += strings.size();
+
+  for (uint i = 0; i < meshes.size(); i++) {
+    const MeshData& mesh = meshes[i];
+    MeshCacheEntry& entry = entries[i];
+
+    uint stride = mesh.layout == VERTEX_LAYOUT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+
+    entry.layout       = mesh.layout;
+    entry.indexSize    = mesh.indexSize;
+    entry.vertexCount  = mesh.uploadVertexCount();
+    entry.indexCount   = mesh.uploadIndexCount();
+    entry.vertexOffset = alignOffset(offset, 16);
+    entry.indexOffset  = alignOffset(entry.vertexOffset + (uint64_t)entry.vertexCount * stride, 16);
+    entry.meshletCount  = mesh.meshlets.size();
+    entry.meshletOffset = alignOffset(entry.indexOffset + (uint64_t)entry.indexCount * entry.indexSize, 16);
+    entry.lodCount      = mesh.lods.size();
+    entry.lodOffset     = alignOffset(entry.meshletOffset + entry.meshletCount * sizeof(Meshlet), 16);
+    offset = entry.lodOffset + entry.lodCount * sizeof(MeshLod);
+
+    for (int k = 0; k < 3; k++) {
+      entry.boundsMin[k] = mesh.boundsMin[k];
+      entry.boundsMax[k] = mesh.boundsMax[k];
+      entry.sphere[k]    = mesh.boundingSphere.center[k];
+    }
+    entry.sphere[3] = mesh.boundingSphere.radius;
+
+    for (int k = 0; k < 3; k++) {
+      entry.positionScale[k]  = mesh.quantization.positionScale[k];
+      entry.positionOffset[k] = mesh.quantization.positionOffset[k];
+    }
+    for (int k = 0; k < 2; k++) {
+      entry.texCoordScale[k]  = mesh.quantization.texCoordScale[k];
+      entry.texCoordOffset[k] = mesh.quantization.texCoordOffset[k];
+    }
+  }
+
+  // write to a temporary and rename so a crash never leaves a half-written cache behind
+  std::string cachePath = meshCachePath(sourcePath, layout);
+  // unique per writer, two loads of the same model (say both layouts) can write at once
+  std::string tempPath  = cachePath + "." + std::to_string(getpid()) + "." +
+      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+  std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+  if (!out) return false;
+
+  out.write((const char*)&header, sizeof(header));
+  out.write((const char*)entries.data(), entries.size() * sizeof(MeshCacheEntry));
+  out.write((const char*)files.data(), files.size() * sizeof(MeshCacheDependency));
+  out.write(strings.data(), strings.size());
+
+  const char padding[16] = {};
+  for (uint i = 0; i < meshes.size(); i++) {
+    const MeshData& mesh = meshes[i];
+    uint stride = mesh.layout == VERTEX_LAYOUT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+    out.write(padding, entries[i].vertexOffset - out.tellp());
+    out.write((const char*)mesh.uploadVertices(), (uint64_t)entries[i].vertexCount * stride);
+    out.write(padding, entries[i].indexOffset - out.tellp());
+    out.write((const char*)mesh.uploadIndices(), (uint64_t)entries[i].indexCount * entries[i].indexSize);
+    out.write(padding, entries[i].meshletOffset - out.tellp());
+    out.write((const char*)mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+    out.write(padding, entries[i].lodOffset - out.tellp());
+    out.write((const char*)mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+  }
+
+  out.close();
+  if (!out || std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+    std::remove(tempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+#endif /* MESHCACHE_H */
@@ -0,0 +1,209 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include "mesh.h"
+#include "hash.h"
+
+/*
+ * load-time mesh optimisation, run on freshly imported meshes before they're cached
+ *
+ *   weldVertices         merges bitwise identical vertices
+ *   optimizeVertexCache  reorders triangles for the post-transform cache (tipsify,
+ *                        sander et al. 2007)
+ *   optimizeVertexFetch  reorders vertices into first-use order so the vertex
+ *                        fetches walk the buffer front to back
+ *
+ * ACMR is transformed vertices per triangle (0.5 is the best a closed mesh can do,
+ * 3 means no reuse at all), ATVR is transformed vertices per unique vertex (1 is ideal)
+ */
+
+#define VERTEX_CACHE_SIZE 16
+
+struct VertexCacheStats {
+  float acmr;
+  float atvr;
+};
+
+struct VertexHash {
+  size_t operator()(const Vertex& v) const { return hashBytes(&v, sizeof(Vertex)); }
+};
+
+struct VertexEqual {
+  bool operator()(const Vertex& a, const Vertex& b) const { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }
+};
+
+// simulates a fifo post-transform cache, which is what most hardware is closest to
+VertexCacheStats analyzeVertexCache(const std::vector<uint>& indices, uint vertexCount, uint cacheSize = VERTEX_CACHE_SIZE) {
+  VertexCacheStats stats = { 0.0f, 0.0f };
+  if (indices.empty() || vertexCount == 0) return stats;
+
+  std::vector<uint> cachedAt(vertexCount, 0);
+  std::vector<bool> used(vertexCount, false);
+  uint misses = 0, unique = 0;
+
+  for (uint index : indices) {
+    if (!used[index]) {
+      used[index] = true;
+      unique++;
+    }
+
+    // a vertex is still cached if fewer than cacheSize misses happened since it was loaded
+    if (cachedAt[index] == 0 || misses - cachedAt[index] >= cacheSize) {
+      misses++;
+      cachedAt[index] = misses;
+    }
+  }
+
+  stats.acmr = (float)misses / (indices.size() / 3);
+  stats.atvr = (float)misses / unique;
+  return stats;
+}
+
+void weldVertices(std::vector<Vertex>& vertices, std::vector<uint>& indices) {
+  std::unordered_map<Vertex, uint, VertexHash, VertexEqual> lookup;
+  lookup.reserve(vertices.size());
+
+  std::vector<uint> remap(vertices.size());
+  std::vector<Vertex> welded;
+  welded.reserve(vertices.size());
+
+  for (uint i = 0; i < vertices.size(); i++) {
+    auto found = lookup.find(vertices[i]);
+    if (found != lookup.end()) {
+      remap[i] = found->second;
+    } else {
+      remap[i] = welded.size();
+      lookup[vertices[i]] = welded.size();
+      welded.push_back(vertices[i]);
+    }
+  }
+
+  for (uint& index : indices) index = remap[index];
+  vertices.swap(welded);
+}
+
+static int tipsifySkipDeadEnd(std::vector<uint>& deadEnds, const std::vector<uint>& liveTriangles, uint& cursor) {
+  while (!deadEnds.empty()) {
+    uint vertex = deadEnds.back();
+    deadEnds.pop_back();
+    if (liveTriangles[vertex] > 0) return vertex;
+  }
+
+  while (cursor < liveTriangles.size()) {
+    if (liveTriangles[cursor] > 0) return cursor;
+    cursor++;
+  }
+
+  return -1;
+}
+
+std::vector<uint> optimizeVertexCache(const std::vector<uint>& indices, uint vertexCount, uint cacheSize = VERTEX_CACHE_SIZE) {
+  uint triangleCount = indices.size() / 3;
+
+  // vertex -> triangles using it, as offsets into one flat array
+  std::vector<uint> liveTriangles(vertexCount, 0);
+  for (uint index : indices) liveTriangles[index]++;
+
+  std::vector<uint> adjacencyOffset(vertexCount + 1, 0);
+  for (uint v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+
+  std::vector<uint> adjacency(indices.size());
+  std::vector<uint> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+  for (uint t = 0; t < triangleCount; t++)
+    for (uint k = 0; k < 3; k++)
+      adjacency[fill[indices[t * 3 + k]]++] = t;
+
+  std::vector<uint> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint> deadEnds;
+  std::vector<uint> candidates;
+  std::vector<uint> output;
+  output.reserve(indices.size());
+
+  uint time = cacheSize + 1;
+  uint cursor = 0;
+  int fan = vertexCount > 0 ? 0 : -1;
+
+  while (fan >= 0) {
+    candidates.clear();
+
+    for (uint a = adjacencyOffset[fan]; a < adjacencyOffset[fan + 1]; a++) {
+      uint t = adjacency[a];
+      if (emitted[t]) continue;
+
+      for (uint k = 0; k < 3; k++) {
+        uint v = indices[t * 3 + k];
+        output.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        liveTriangles[v]--;
+
+        if (time - cacheTime[v] > cacheSize) {
+          cacheTime[v] = time;
+          time++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    // next fan: the candidate that will still be in the cache after its remaining
+    // triangles are emitted and has been there longest, else back out of the dead end
+    int best = -1, bestPriority = -1;
+    for (uint v : candidates) {
+      if (liveTriangles[v] == 0) continue;
+
+      int priority = 0;
+      if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) priority = time - cacheTime[v];
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        best = v;
+      }
+    }
+
+    fan = best >= 0 ? best : tipsifySkipDeadEnd(deadEnds, liveTriangles, cursor);
+  }
+
+  return output;
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint>& indices) {
+  std::vector<uint> remap(vertices.size(), UINT32_MAX);
+  std::vector<Vertex> ordered;
+  ordered.reserve(vertices.size());
+
+  for (uint& index : indices) {
+    if (remap[index] == UINT32_MAX) {
+      remap[index] = ordered.size();
+      ordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  vertices.swap(ordered);
+}
+
+// runs all three passes on an imported mesh and reports how much they helped
+void optimizeMesh(MeshData& mesh, const std::string& name) {
+  if (mesh.indices.empty()) return;
+
+  uint vertexCountBefore = mesh.vertices.size();
+  VertexCacheStats before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+  weldVertices(mesh.vertices, mesh.indices);
+  mesh.indices = optimizeVertexCache(mesh.indices, mesh.vertices.size());
+  optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+  VertexCacheStats after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+  std::cout << "INFO::MESHOPT::" << name
+            << " vertices " << vertexCountBefore << " -> " << mesh.vertices.size()
+            << ", ACMR "    << before.acmr << " -> " << after.acmr
+            << ", ATVR "    << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+#endif /* MESHOPTIMIZER_H */
@@ -0,0 +1,301 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "meshOptimizer.h"
+
+/*
+ * lod chain generation, edge collapse driven by quadric error metrics (garland & heckbert 1997)
+ *
+ * lods only get new index lists, every level draws from the full mesh's vertex buffer,
+ * so a collapse moves one vertex onto a neighbour instead of inventing a new position.
+ * vertices on a uv seam (same position, different attributes) or on an open border are
+ * locked, collapsing them would tear the texture or the silhouette apart
+ *
+ * a level's error is the worst collapse's area weighted quadric error, as a distance in model
+ * space (on asteroid1 it lands just above the measured worst vertex distance), and is what
+ * Prop compares against a pixel threshold once it's projected onto the screen
+ */
+
+// including the full mesh
+#define MESH_LOD_COUNT         4
+// each level aims for this fraction of the triangles of the one before
+#define MESH_LOD_REDUCTION     0.5f
+// meshes smaller than this aren't worth simplifying
+#define MESH_LOD_MIN_TRIANGLES 256
+
+// symmetric 4x4 matrix as its upper triangle, summed in doubles since it adds up thousands of planes
+struct Quadric {
+  double a2 = 0, ab = 0, ac = 0, ad = 0;
+  double b2 = 0, bc = 0, bd = 0;
+  double c2 = 0, cd = 0;
+  double d2 = 0;
+  // total area of the planes' triangles
+  double weight = 0;
+
+  void addPlane(glm::vec3 n, float d, float area);
+  Quadric& operator+=(const Quadric& q);
+  double error(glm::vec3 p) const;
+};
+
+void Quadric::addPlane(glm::vec3 n, float d, float area) {
+  a2 += area * n.x * n.x; ab += area * n.x * n.y; ac += area * n.x * n.z; ad += area * n.x * d;
+  b2 += area * n.y * n.y; bc += area * n.y * n.z; bd += area * n.y * d;
+  c2 += area * n.z * n.z; cd += area * n.z * d;
+  d2 += area * d * d;
+  weight += area;
+}
+
+Quadric& Quadric::operator+=(const Quadric& q) {
+  a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+  b2 += q.b2; bc += q.bc; bd += q.bd;
+  c2 += q.c2; cd += q.cd;
+  d2 += q.d2;
+  weight += q.weight;
+  return *this;
+}
+
+// squared distance from p to the quadric's planes, averaged over their area
+double Quadric::error(glm::vec3 p) const {
+  if (weight == 0) return 0;
+
+  double x = p.x, y = p.y, z = p.z;
+  double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+           + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+           + c2 * z * z + 2 * cd * z
+           + d2;
+  return std::max(e / weight, 0.0);
+}
+
+struct Collapse {
+  uint   from, to;
+  double cost;
+};
+
+// vertices sharing a position get the lowest index among them, so seams can be told apart
+static std::vector<uint> positionRemap(const Vertex* vertices, uint vertexCount) {
+  std::vector<uint> order(vertexCount);
+  for (uint i = 0; i < vertexCount; i++) order[i] = i;
+
+  auto less = [&](uint a, uint b) {
+    const glm::vec3& p = vertices[a].position;
+    const glm::vec3& q = vertices[b].position;
+    if (p.x != q.x) return p.x < q.x;
+    if (p.y != q.y) return p.y < q.y;
+    if (p.z != q.z) return p.z < q.z;
+    return a < b;
+  };
+  std::sort(order.begin(), order.end(), less);
+
+  std::vector<uint> remap(vertexCount);
+  for (uint i = 0; i < vertexCount; i++) {
+    bool same = i > 0 && vertices[order[i]].position == vertices[order[i - 1]].position;
+    remap[order[i]] = same ? remap[order[i - 1]] : order[i];
+  }
+  return remap;
+}
+
+// simplifies one mesh step by step, each simplify() carries on from where the last left off,
+// so every level's error is measured against the full mesh and not the level before it
+class MeshSimplifier {
+  public:
+    MeshSimplifier(const Vertex* vertices, uint vertexCount, const std::vector<uint>& indices);
+
+    // collapses edges until at most targetIndexCount indices are left or nothing more can go
+    void simplify(uint targetIndexCount);
+
+    std::vector<uint> indices;
+    // largest collapse error so far, as a distance
+    float error;
+
+  private:
+    const Vertex* _vertices;
+    uint          _vertexCount;
+
+    // every vertex's representative among the ones sharing its position
+    std::vector<uint>    _position;
+    std::vector<bool>    _locked;
+    std::vector<Quadric> _quadrics;
+    double               _maxCost;
+};
+
+MeshSimplifier::MeshSimplifier(const Vertex* vertices, uint vertexCount, const std::vector<uint>& indices)
+  : indices(indices), error(0.0f), _vertices(vertices), _vertexCount(vertexCount), _maxCost(0.0) {
+  _position = positionRemap(vertices, vertexCount);
+
+  // seams: more than one vertex on the same position
+  std::vector<uint> wedges(vertexCount, 0);
+  for (uint v = 0; v < vertexCount; v++) wedges[_position[v]]++;
+
+  _locked.assign(vertexCount, false);
+  for (uint v = 0; v < vertexCount; v++)
+    if (wedges[_position[v]] > 1) _locked[_position[v]] = true;
+
+  // borders: edges (between positions, so seams don't count) used by only one triangle
+  std::unordered_map<uint64_t, uint> edges;
+  edges.reserve(indices.size());
+  for (uint i = 0; i < indices.size(); i += 3) {
+    for (uint k = 0; k < 3; k++) {
+      uint a = _position[indices[i + k]], b = _position[indices[i + (k + 1) % 3]];
+      edges[(uint64_t)std::min(a, b) << 32 | std::max(a, b)]++;
+    }
+  }
+  for (const auto& edge : edges) {
+    if (edge.second != 2) {
+      _locked[edge.first >> 32] = true;
+      _locked[edge.first & 0xffffffff] = true;
+    }
+  }
+
+  _quadrics.assign(vertexCount, Quadric());
+  for (uint i = 0; i < indices.size(); i += 3) {
+    glm::vec3 a = vertices[indices[i]].position;
+    glm::vec3 b = vertices[indices[i + 1]].position;
+    glm::vec3 c = vertices[indices[i + 2]].position;
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float length = glm::length(normal);
+    if (length == 0.0f) continue;
+
+    normal /= length;
+    for (uint k = 0; k < 3; k++)
+      _quadrics[_position[indices[i + k]]].addPlane(normal, -glm::dot(normal, a), length * 0.5f);
+  }
+}
+
+void MeshSimplifier::simplify(uint targetIndexCount) {
+  const Vertex* vertices = _vertices;
+  uint vertexCount = _vertexCount;
+
+  std::vector<uint> remap(vertexCount);
+  std::vector<bool> touched(vertexCount);
+  std::vector<uint> adjacencyOffset(vertexCount + 1);
+  std::vector<uint> adjacency;
+  std::vector<Collapse> collapses;
+
+  while (indices.size() > targetIndexCount) {
+    uint triangleCount = indices.size() / 3;
+
+    // vertex -> triangles using it, rebuilt every pass since the triangles change
+    std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+    for (uint index : indices) adjacencyOffset[index + 1]++;
+    for (uint v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] += adjacencyOffset[v];
+    adjacency.resize(indices.size());
+    std::vector<uint> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (uint t = 0; t < triangleCount; t++)
+      for (uint k = 0; k < 3; k++)
+        adjacency[fill[indices[t * 3 + k]]++] = t;
+
+    // every directed edge whose start is free to move, cheapest first
+    collapses.clear();
+    for (uint i = 0; i < indices.size(); i += 3) {
+      for (uint k = 0; k < 3; k++) {
+        uint a = indices[i + k], b = indices[i + (k + 1) % 3];
+        if (_position[a] == _position[b]) continue;
+
+        Quadric q = _quadrics[_position[a]];
+        q += _quadrics[_position[b]];
+        if (!_locked[_position[a]]) collapses.push_back({ a, b, q.error(vertices[b].position) });
+        if (!_locked[_position[b]]) collapses.push_back({ b, a, q.error(vertices[a].position) });
+      }
+    }
+    if (collapses.empty()) break;
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+    for (uint v = 0; v < vertexCount; v++) remap[v] = v;
+    std::fill(touched.begin(), touched.end(), false);
+
+    // a collapse takes about two triangles with it
+    uint wanted = (triangleCount - targetIndexCount / 3 + 1) / 2;
+    uint applied = 0;
+
+    for (const Collapse& collapse : collapses) {
+      if (applied >= wanted) break;
+      if (touched[_position[collapse.from]] || touched[_position[collapse.to]]) continue;
+
+      // moving `from` onto `to` mustn't turn any of its remaining triangles over
+      glm::vec3 target = vertices[collapse.to].position;
+      bool flips = false;
+      for (uint a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1] && !flips; a++) {
+        const uint* triangle = &indices[adjacency[a] * 3];
+        glm::vec3 p[3], q[3];
+        bool vanishes = false;
+        for (uint k = 0; k < 3; k++) {
+          p[k] = q[k] = vertices[triangle[k]].position;
+          if (triangle[k] == collapse.from) q[k] = target;
+          if (_position[triangle[k]] == _position[collapse.to]) vanishes = true;
+        }
+        if (vanishes) continue;
+
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 after  = glm::cross(q[1] - q[0], q[2] - q[0]);
+        flips = glm::dot(before, after) <= 0.0f;
+      }
+      if (flips) continue;
+
+      // everything around the collapse is off limits for the rest of the pass, the
+      // flip test above relies on the neighbourhood not having moved yet
+      for (uint a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; a++)
+        for (uint k = 0; k < 3; k++)
+          touched[_position[indices[adjacency[a] * 3 + k]]] = true;
+
+      remap[collapse.from] = collapse.to;
+      _quadrics[_position[collapse.to]] += _quadrics[_position[collapse.from]];
+      _maxCost = std::max(_maxCost, collapse.cost);
+      applied++;
+    }
+    if (applied == 0) break;
+
+    uint kept = 0;
+    for (uint i = 0; i < indices.size(); i += 3) {
+      uint a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+      if (_position[a] == _position[b] || _position[b] == _position[c] || _position[c] == _position[a]) continue;
+
+      indices[kept++] = a;
+      indices[kept++] = b;
+      indices[kept++] = c;
+    }
+    indices.resize(kept);
+  }
+
+  error = (float)std::sqrt(_maxCost);
+}
+
+// appends simplified index lists after the full mesh's, see MeshData::lods. stops early
+// once a level barely gets smaller, seams and borders put a floor under how far it can go
+void buildLods(MeshData& mesh, const std::string& name) {
+  if (mesh.indices.size() / 3 < MESH_LOD_MIN_TRIANGLES) return;
+
+  uint fullCount = mesh.indices.size();
+  mesh.lods.push_back({ 0, fullCount, 0.0f });
+
+  MeshSimplifier simplifier(mesh.vertices.data(), mesh.vertices.size(), mesh.indices);
+
+  for (uint level = 1; level < MESH_LOD_COUNT; level++) {
+    uint previous = simplifier.indices.size();
+    uint target = (uint)(previous / 3 * MESH_LOD_REDUCTION) * 3;
+    if (target / 3 < MESH_LOD_MIN_TRIANGLES / 4) break;
+
+    simplifier.simplify(target);
+    if (simplifier.indices.size() > previous * 0.9f) break;
+
+    std::vector<uint> simplified = optimizeVertexCache(simplifier.indices, mesh.vertices.size());
+    mesh.lods.push_back({ (uint)mesh.indices.size(), (uint)simplified.size(), simplifier.error });
+    mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+  }
+
+  std::cout << "INFO::MESHLOD::" << name << " triangles";
+  for (const MeshLod& lod : mesh.lods) std::cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+  std::cout << std::endl;
+
+  if (mesh.lods.size() == 1) mesh.lods.clear();
+}
+
+#endif /* MESHSIMPLIFIER_H */
@@ -0,0 +1,197 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "frustum.h"
+
+/*
+ * meshlets: runs of at most 64 vertices / 124 triangles of a mesh's index buffer,
+ * each with a bounding sphere and a cone around its triangle normals. clusters
+ * that are off screen, or whose every triangle faces away from the camera, are
+ * skipped and the rest are drawn as ranges of the one index buffer
+ *
+ * run after optimizeMesh: meshlets are seeded in its vertex cache order and keep
+ * most of that order, so the post-transform cache still does well
+ */
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+// meshes with fewer triangles than this are drawn whole, culling wouldn't pay for the extra draws
+#define MESHLET_MIN_TRIANGLES (MESHLET_MAX_TRIANGLES * 4)
+
+struct Meshlet {
+  uint firstIndex;
+  uint indexCount;
+
+  glm::vec3 center;
+  float     radius;
+
+  // backfacing if dot(center - camera, coneAxis) >= coneCutoff * |center - camera| + radius,
+  // a cutoff of 1 (normals too spread out) never culls
+  glm::vec3 coneAxis;
+  float     coneCutoff;
+};
+
+// templated on the vertex type so mesh.h can include this before Vertex exists, needs a .position
+template <typename V>
+static Meshlet finishMeshlet(const V* vertices, const uint* indices, uint firstIndex, uint indexCount) {
+  Meshlet meshlet;
+  meshlet.firstIndex = firstIndex;
+  meshlet.indexCount = indexCount;
+
+  glm::vec3 lo = vertices[indices[firstIndex]].position, hi = lo;
+  glm::vec3 normalSum(0.0f);
+  std::vector<glm::vec3> normals;
+
+  for (uint i = firstIndex; i < firstIndex + indexCount; i += 3) {
+    glm::vec3 a = vertices[indices[i]].position;
+    glm::vec3 b = vertices[indices[i + 1]].position;
+    glm::vec3 c = vertices[indices[i + 2]].position;
+    lo = glm::min(lo, glm::min(a, glm::min(b, c)));
+    hi = glm::max(hi, glm::max(a, glm::max(b, c)));
+
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float area = glm::length(normal);
+    if (area > 0.0f) {
+      normals.push_back(normal / area);
+      normalSum += normal / area;
+    }
+  }
+
+  meshlet.center = (lo + hi) * 0.5f;
+  meshlet.radius = 0.0f;
+  for (uint i = firstIndex; i < firstIndex + indexCount; i++)
+    meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].position - meshlet.center));
+
+  meshlet.coneAxis   = glm::vec3(0.0f, 0.0f, 1.0f);
+  meshlet.coneCutoff = 1.0f;
+
+  float axisLength = glm::length(normalSum);
+  if (axisLength > 0.0f) {
+    meshlet.coneAxis = normalSum / axisLength;
+
+    float minDot = 1.0f;
+    for (glm::vec3 normal : normals) minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+
+    // sin of the cone's half angle, cones wider than ~85 degrees can't ever be culled
+    if (minDot > 0.1f) meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+  }
+
+  return meshlet;
+}
+
+// grows each meshlet out over shared vertices, preferring triangles that add the fewest new
+// vertices and then the ones facing the same way as the meshlet so far (tighter cones cull
+// more). rewrites indices so every meshlet is one contiguous range
+template <typename V>
+std::vector<Meshlet> buildMeshlets(const V* vertices, uint vertexCount, std::vector<uint>& indices) {
+  std::vector<Meshlet> meshlets;
+  uint triangleCount = indices.size() / 3;
+  if (triangleCount < MESHLET_MIN_TRIANGLES) return meshlets;
+
+  std::vector<glm::vec3> normals(triangleCount);
+  for (uint t = 0; t < triangleCount; t++) {
+    glm::vec3 a = vertices[indices[t * 3]].position;
+    glm::vec3 normal = glm::cross(vertices[indices[t * 3 + 1]].position - a, vertices[indices[t * 3 + 2]].position - a);
+    float area = glm::length(normal);
+    normals[t] = area > 0.0f ? normal / area : glm::vec3(0.0f);
+  }
+
+  // vertex -> triangles using it, as offsets into one flat array
+  std::vector<uint> adjacencyOffset(vertexCount + 1, 0);
+  for (uint index : indices) adjacencyOffset[index + 1]++;
+  for (uint v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] += adjacencyOffset[v];
+
+  std::vector<uint> adjacency(indices.size());
+  std::vector<uint> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+  for (uint t = 0; t < triangleCount; t++)
+    for (uint k = 0; k < 3; k++)
+      adjacency[fill[indices[t * 3 + k]]++] = t;
+
+  // stamp per vertex instead of a set, a vertex is in the current meshlet if its stamp matches
+  std::vector<uint> stamp(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint> candidates;
+  std::vector<uint> output;
+  output.reserve(indices.size());
+
+  uint current = 0, cursor = 0;
+  uint triangles = 0, unique = 0;
+  glm::vec3 normalSum(0.0f);
+
+  while (output.size() < indices.size()) {
+    int best = -1;
+    uint bestAdded = 4;
+    float bestDot = -2.0f;
+    glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+
+    // drops triangles emitted since they were queued while scanning
+    uint live = 0;
+    for (uint t : candidates) {
+      if (emitted[t]) continue;
+      candidates[live++] = t;
+
+      uint added = 0;
+      for (uint k = 0; k < 3; k++)
+        if (stamp[indices[t * 3 + k]] != current) added++;
+      float dot = glm::dot(normals[t], axis);
+
+      if (added < bestAdded || (added == bestAdded && dot > bestDot)) {
+        best = t;
+        bestAdded = added;
+        bestDot = dot;
+      }
+    }
+    candidates.resize(live);
+
+    // start a new meshlet when this one is full or has nowhere left to grow,
+    // seeded from the next triangle in the vertex cache order
+    if (best < 0 || triangles == MESHLET_MAX_TRIANGLES || unique + bestAdded > MESHLET_MAX_VERTICES) {
+      if (triangles > 0) {
+        uint first = output.size() - triangles * 3;
+        meshlets.push_back(finishMeshlet(vertices, output.data(), first, triangles * 3));
+      }
+
+      while (emitted[cursor]) cursor++;
+      best = cursor;
+      current++;
+      triangles = unique = 0;
+      normalSum = glm::vec3(0.0f);
+      candidates.clear();
+    }
+
+    emitted[best] = true;
+    triangles++;
+    normalSum += normals[best];
+
+    for (uint k = 0; k < 3; k++) {
+      uint v = indices[best * 3 + k];
+      output.push_back(v);
+      if (stamp[v] == current) continue;
+
+      stamp[v] = current;
+      unique++;
+      for (uint a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; a++)
+        if (!emitted[adjacency[a]]) candidates.push_back(adjacency[a]);
+    }
+  }
+
+  uint first = output.size() - triangles * 3;
+  meshlets.push_back(finishMeshlet(vertices, output.data(), first, triangles * 3));
+
+  indices.swap(output);
+  return meshlets;
+}
+
+// camera and frustum both in the mesh's model space
+bool meshletVisible(const Meshlet& meshlet, const Frustum& frustum, glm::vec3 camera) {
+  glm::vec3 toCenter = meshlet.center - camera;
+  if (glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius) return false;
+  return frustum.intersectsSphere(meshlet.center, meshlet.radius);
+}
+
+#endif /* MESHLET_H */
@@ -1,131 +1,430 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <memory>
+#include <unordered_set>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/DefaultIOSystem.h>
 #include "mesh.h"
+#include "meshCache.h"
+#include "objLoader.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "textureCache.h"
+#include "threadPool.h"
+#include "assetPack.h"
+#include "vertexConversion.h"
+
+// everything the cpu side of loading a model produces, none of it touches gl
+struct ModelData {
+  std::string path;
+  std::string directory;
+
+  std::vector<MeshData> meshes;
+  // the other files the import read (an obj's mtl), the mesh cache is checked against them too
+  std::vector<std::string> dependencies;
+  // keeps a mapped cache alive while the meshes point into it
+  std::shared_ptr<MeshCache> cache;
+
+  // every texture the meshes reference once, with its decoded pixels at the same index
+  std::vector<TextureRef> textures;
+  std::vector<Image>      images;
+
+  glm::vec3 boundsMin = glm::vec3(0.0f);
+  glm::vec3 boundsMax = glm::vec3(0.0f);
+  BoundingSphere boundingSphere;
+
+  // per lod, the worst error of any mesh at that level
+  std::vector<float> lodErrors;
+};
+
+// assimp's own file access, noting every file besides the model it looks for or opens
+// (an obj's mtl) so they can go into ModelData::dependencies
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+  public:
+    RecordingIOSystem(std::string path, std::vector<std::string>& files)
+      : _path(path), _files(files) {
+    }
+
+    bool Exists(const char* file) const override {
+      record(file);
+      return DefaultIOSystem::Exists(file);
+    }
+
+    Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+      record(file);
+      return DefaultIOSystem::Open(file, mode);
+    }
+
+  private:
+    std::string _path;
+    std::vector<std::string>& _files;
+
+    void record(const char* file) const {
+      if (file == _path || std::find(_files.begin(), _files.end(), file) != _files.end()) return;
+      _files.push_back(file);
+    }
+};
 
 class Model {
   public:
-    Model(std::string path) {
-      loadModel(path);
+    // empty and not resident, filled in piece by piece by ModelStreamer
+    Model();
+    // blocks until the model is imported and uploaded. with VERTEX_LAYOUT_PACKED every mesh
+    // whose bounds allow it is quantised to 16 byte vertices, the rest stay float
+    Model(std::string path, VertexLayout layout = VERTEX_LAYOUT_FLOAT)
+      : boundsMin(0.0f), boundsMax(0.0f), resident(false) {
+      loadModel(path, layout);
     }
+    // frees the meshes and lets go of the textures, so the last owner has to be on the gl thread
+    ~Model();
+
+    // owns gl objects, share it through a shared_ptr (see AssetManager) instead
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    Model(Model&&) = default;
+    Model& operator=(Model&&) = default;
 
     void draw(Shader &shader);
+    // culls the whole model, then each mesh's meshlets. frustum and camera in model space
+    void draw(Shader &shader, const Frustum& frustum, glm::vec3 camera, uint lod = 0);
+    // every mesh, each range at its lod, see Mesh::drawInstanced
+    void drawInstanced(Shader &shader, uint buffer, const std::vector<InstanceRange>& ranges);
+    // true once loading is over, a model that failed to import is resident with no meshes
+    bool isResident() const;
+
+    // known as soon as the import has finished, which is before the model is resident
+    glm::vec3 boundsMin, boundsMax;
+    BoundingSphere boundingSphere;
+
+    // 1 for models that weren't simplified. the error is in model space, see MeshLod
+    uint lodCount() const;
+    float lodError(uint lod) const;
+
+    // the first mesh's, for render queue sort keys. 0 until it's uploaded
+    uint vertexArray() const { return meshes.empty() ? 0 : meshes[0].vertexArray(); }
+    uint firstTexture() const { return meshes.empty() ? 0 : meshes[0].firstTexture(); }
+
+    // the model covers about `pixels` across on screen this frame, lets TextureStreamer
+    // bring its textures' detail up or down to match
+    void requestTextureDetail(float pixels);
+
+    // cpu half of loading, safe to run on any thread
+    static bool import(std::string path, ModelData& data, VertexLayout layout = VERTEX_LAYOUT_FLOAT);
+    static void decodeTextures(ModelData& data);
+    // decodes into data.images[index] (which must exist), skipped if TextureCache already has it
+    static void decodeTexture(ModelData& data, uint index);
+
+    // gl half of loading, the constructor does it all at once, ModelStreamer spreads it over frames
+    void begin(const ModelData& data);
+    void addTexture(ModelData& data, uint index);
+    // frees the mesh's cpu arrays in data once they're uploaded
+    void addMesh(ModelData& data, uint index);
+    void finish();
+
   private:
-    std::vector<Texture> loadedTextures;
+    // keeps the model's textures resident in TextureCache
+    std::vector<std::shared_ptr<Texture>> loadedTextures;
     std::vector<Mesh> meshes;
     std::string directory;
+    std::vector<float> lodErrors;
+    bool resident;
+
+    void loadModel(std::string path, VertexLayout layout);
+    MeshTexture materialTexture(const ModelData& data, const TextureRef& ref);
 
-    void loadModel(std::string path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+    static bool importCached(std::string path, ModelData& data, VertexLayout layout);
+    static bool importObj(std::string path, ModelData& data);
+    static bool importAssimp(std::string path, ModelData& data);
+    static void processNode(aiNode* node, const aiScene* scene, ModelData& data);
+    static MeshData processMesh(aiMesh* mesh, const aiScene* scene);
+    static void loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName, std::vector<TextureRef>& textures);
 };
 
+Model::Model()
+  : boundsMin(0.0f), boundsMax(0.0f), resident(false) {
+}
+
+// the meshes and textures delete their gl objects themselves
+Model::~Model() {
+}
+
 void Model::draw(Shader &shader) {
   for (uint i = 0; i < meshes.size(); i++) {
     meshes[i].draw(shader);
   }
 }
 
-void Model::loadModel(std::string path) {
+void Model::draw(Shader &shader, const Frustum& frustum, glm::vec3 camera, uint lod) {
+  if (!frustum.intersectsSphere(boundingSphere.center, boundingSphere.radius)) return;
+
+  for (uint i = 0; i < meshes.size(); i++) {
+    meshes[i].draw(shader, frustum, camera, lod);
+  }
+}
+
+void Model::drawInstanced(Shader &shader, uint buffer, const std::vector<InstanceRange>& ranges) {
+  for (uint i = 0; i < meshes.size(); i++) {
+    meshes[i].drawInstanced(shader, buffer, ranges);
+  }
+}
+
+bool Model::isResident() const {
+  return resident;
+}
+
+uint Model::lodCount() const {
+  return std::max((uint)lodErrors.size(), 1u);
+}
+
+float Model::lodError(uint lod) const {
+  return lod < lodErrors.size() ? lodErrors[lod] : 0.0f;
+}
+
+void Model::requestTextureDetail(float pixels) {
+  for (const std::shared_ptr<Texture>& texture : loadedTextures)
+    TextureStreamer::shared().request(texture->id, pixels);
+}
+
+void Model::loadModel(std::string path, VertexLayout layout) {
+  ModelData data;
+  if (!import(path, data, layout)) {
+    finish();
+    return;
+  }
+  decodeTextures(data);
+
+  begin(data);
+  for (uint i = 0; i < data.textures.size(); i++) addTexture(data, i);
+  for (uint i = 0; i < data.meshes.size(); i++)   addMesh(data, i);
+  finish();
+}
+
+bool Model::import(std::string path, ModelData& data, VertexLayout layout) {
+  LoadAsset asset(path);
+  data.path      = path;
+  data.directory = path.substr(0, path.find_last_of('/'));
+
+  if (importCached(path, data, layout)) {
+    LoadProfiler::shared().setCached(path);
+  } else {
+    if (!importObj(path, data) && !importAssimp(path, data)) return false;
+
+    LoadTimer timer(LOAD_STAGE_PROCESS);
+    for (uint i = 0; i < data.meshes.size(); i++) {
+      optimizeMesh(data.meshes[i], path + "[" + std::to_string(i) + "]");
+      data.meshes[i].computeBounds();
+
+      MeshData& mesh = data.meshes[i];
+      mesh.meshlets = buildMeshlets(mesh.vertices.data(), mesh.vertices.size(), mesh.indices);
+      buildLods(mesh, path + "[" + std::to_string(i) + "]");
+      mesh.prepareUpload(layout);
+    }
+
+    LoadTimer writeTimer(LOAD_STAGE_CACHE_WRITE);
+    if (!MeshCache::write(path, layout, data.dependencies, data.meshes))
+      std::cout << "WARNING::MESHCACHE::WRITE_FAILED '" << meshCachePath(path, layout) << "'" << std::endl;
+  }
+
+  std::unordered_set<std::string> known;
+  for (uint i = 0; i < data.meshes.size(); i++) {
+    MeshData& mesh = data.meshes[i];
+    data.boundsMin = i == 0 ? mesh.boundsMin : glm::min(data.boundsMin, mesh.boundsMin);
+    data.boundsMax = i == 0 ? mesh.boundsMax : glm::max(data.boundsMax, mesh.boundsMax);
+    data.boundingSphere = i == 0 ? mesh.boundingSphere : mergeSpheres(data.boundingSphere, mesh.boundingSphere);
+
+    for (const TextureRef& ref : mesh.textures)
+      if (known.insert(ref.path).second) data.textures.push_back(ref);
+
+    if (mesh.lods.size() > data.lodErrors.size()) data.lodErrors.resize(mesh.lods.size(), 0.0f);
+  }
+
+  // spheres merged mesh by mesh drift away from the middle of models made of many parts
+  BoundingSphere box = boxSphere(data.boundsMin, data.boundsMax);
+  if (box.radius < data.boundingSphere.radius) data.boundingSphere = box;
+
+  // meshes with fewer lods keep drawing their last one, so they count towards every level after it too
+  for (const MeshData& mesh : data.meshes) {
+    for (uint lod = 0; lod < data.lodErrors.size() && !mesh.lods.empty(); lod++) {
+      float error = mesh.lods[std::min(lod, (uint)mesh.lods.size() - 1)].error;
+      data.lodErrors[lod] = std::max(data.lodErrors[lod], error);
+    }
+  }
+
+  return true;
+}
+
+// decodes every texture the model needs on the thread pool at once
+void Model::decodeTextures(ModelData& data) {
+  data.images.resize(data.textures.size());
+
+  std::vector<std::future<void>> pending;
+  for (uint i = 0; i < data.textures.size(); i++)
+    pending.push_back(ThreadPool::shared().submit([&data, i]() { decodeTexture(data, i); }));
+
+  for (std::future<void>& decode : pending) decode.get();
+}
+
+void Model::decodeTexture(ModelData& data, uint index) {
+  std::string file = data.directory + "/" + data.textures[index].path;
+  Image& image = data.images[index];
+
+  if (TextureCache::shared().find(file)) {
+    image.path = file;
+    image.data = nullptr;
+    image.contentHash = 0;
+    return;
+  }
+  image = loadImage(file);
+}
+
+void Model::begin(const ModelData& data) {
+  directory = data.directory;
+  boundsMin = data.boundsMin;
+  boundsMax = data.boundsMax;
+  boundingSphere = data.boundingSphere;
+  lodErrors = data.lodErrors;
+}
+
+void Model::addTexture(ModelData& data, uint index) {
+  if (index < data.images.size())
+    loadedTextures.push_back(TextureCache::shared().acquire(data.images[index], true));
+  else
+    loadedTextures.push_back(TextureCache::shared().acquire(directory + "/" + data.textures[index].path, true));
+}
+
+void Model::addMesh(ModelData& data, uint index) {
+  LoadAsset asset(data.path);
+  MeshData& mesh = data.meshes[index];
+
+  std::vector<MeshTexture> textures;
+  for (const TextureRef& ref : mesh.textures)
+    textures.push_back(materialTexture(data, ref));
+
+  meshes.emplace_back(mesh, std::move(textures));
+
+  // only the gpu copy is needed from here on, the rest of the model shouldn't wait on
+  // the whole ModelData going away to give the memory back
+  std::vector<Vertex>().swap(mesh.vertices);
+  std::vector<uint>().swap(mesh.indices);
+  std::vector<PackedVertex>().swap(mesh.packedVertices);
+  std::vector<uint16_t>().swap(mesh.shortIndices);
+}
+
+void Model::finish() {
+  resident = true;
+}
+
+bool Model::importCached(std::string path, ModelData& data, VertexLayout layout) {
+  std::shared_ptr<MeshCache> cache = std::make_shared<MeshCache>(path, layout);
+  if (!cache->open()) return false;
+
+  data.meshes = cache->meshes;
+  data.cache  = cache;
+  return true;
+}
+
+// obj files go through our own parser, anything else (or an obj it chokes on) through assimp
+bool Model::importObj(std::string path, ModelData& data) {
+  if (path.substr(path.find_last_of('.') + 1) != "obj") return false;
+
+  LoadTimer timer(LOAD_STAGE_PARSE);
+  ObjLoader loader(path);
+  if (!loader.load()) return false;
+
+  data.meshes       = std::move(loader.meshes);
+  data.dependencies = std::move(loader.materialLibraries);
+  return true;
+}
+
+bool Model::importAssimp(std::string path, ModelData& data) {
   Assimp::Importer importer;
-  const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+  const aiScene* scene;
+
+  // a packed model is read from memory, so only formats that keep everything in one file work from the pack
+  LoadTimer timer(LOAD_STAGE_PARSE);
+  MappedFile packed;
+  if (AssetPack::shared().contains(path) && packed.open(path)) {
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    scene = importer.ReadFileFromMemory(packed.data(), packed.size(), aiProcess_Triangulate, extension.c_str());
+  } else {
+    // the importer deletes its io handler
+    importer.SetIOHandler(new RecordingIOSystem(path, data.dependencies));
+    scene = importer.ReadFile(path, aiProcess_Triangulate);
+    // assimp reads the file itself rather than through MappedFile
+    LoadProfiler::shared().addRead(path, std::max(fileSize(path), (int64_t)0));
+  }
 
   if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
     std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-    return;
+    return false;
   }
 
-  directory = path.substr(0, path.find_last_of('/'));
-
-  processNode(scene->mRootNode, scene);
+  LoadTimer processTimer(LOAD_STAGE_PROCESS);
+  processNode(scene->mRootNode, scene, data);
+  return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
+void Model::processNode(aiNode* node, const aiScene* scene, ModelData& data) {
   for (uint i = 0; i < node->mNumMeshes; i++) {
     aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-    meshes.push_back(processMesh(mesh, scene));
+    data.meshes.push_back(processMesh(mesh, scene));
   }
 
   for (uint i = 0; i < node->mNumChildren; i++) {
-    processNode(node->mChildren[i], scene);
+    processNode(node->mChildren[i], scene, data);
   }
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-  std::vector<Vertex> vertices;
-  std::vector<uint> indices;
-  std::vector<Texture> textures;
-
-  for (uint i = 0; i < mesh->mNumVertices; i++) {
-    Vertex vertex;
-    vertex.position = glm::vec3(
-        mesh->mVertices[i].x,
-        mesh->mVertices[i].y,
-        mesh->mVertices[i].z
-        );
-    vertex.normal = glm::vec3(
-        mesh->mNormals[i].x,
-        mesh->mNormals[i].y,
-        mesh->mNormals[i].z
-        );
-
-    if (mesh->mTextureCoords[0]) {
-        vertex.texCoords.x = mesh->mTextureCoords[0][i].x;
-        vertex.texCoords.y = mesh->mTextureCoords[0][i].y;
-    } else {
-      vertex.texCoords = glm::vec2(0.0f, 0.0f);
-    }
+static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "vertexConversion.h reads assimp's vectors as 3 floats");
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "vertexConversion.h writes a Vertex as 8 floats");
 
-    vertices.push_back(vertex);
-  }
+MeshData Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+  MeshData data;
+
+  data.vertices.resize(mesh->mNumVertices);
+  convertVertices((const float*)mesh->mVertices, (const float*)mesh->mNormals,
+      (const float*)mesh->mTextureCoords[0], mesh->mNumVertices, data.vertices.data());
+
+  // sized exactly first, every face after aiProcess_Triangulate is a triangle but points
+  // and lines come through as they are
+  size_t indexCount = 0;
+  for (uint i = 0; i < mesh->mNumFaces; i++) indexCount += mesh->mFaces[i].mNumIndices;
+  data.indices.resize(indexCount);
 
+  uint* index = data.indices.data();
   for (uint i = 0; i < mesh->mNumFaces; i++) {
-    aiFace face = mesh->mFaces[i];
-    for (uint j = 0; j < face.mNumIndices; j++) {
-      indices.push_back(face.mIndices[j]);
-    }
+    const aiFace& face = mesh->mFaces[i];
+    std::memcpy(index, face.mIndices, face.mNumIndices * sizeof(uint));
+    index += face.mNumIndices;
   }
 
   if (mesh->mMaterialIndex >= 0) {
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-    std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-    std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    loadMaterialTextures(material, aiTextureType_DIFFUSE,  "texture_diffuse",  data.textures);
+    loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
   }
 
-  return Mesh(vertices, indices, textures);
+  return data;
 }
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
-  std::vector<Texture> textures;
+void Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName, std::vector<TextureRef>& textures) {
   for (uint i = 0; i < mat->GetTextureCount(type); i++) {
     aiString str;
     mat->GetTexture(type, i, &str);
-
-    bool textureAlreadyLoaded = false;
-    for (uint j = 0; j < loadedTextures.size(); j++) {
-      if (std::strcmp(loadedTextures[j].path.data(), str.C_Str()) == 0){
-        textures.push_back(loadedTextures[j]);
-        textureAlreadyLoaded = true;
-      }
-    }
-    if (!textureAlreadyLoaded) {
-      Texture texture;
-      texture.id = loadTexture(directory + "/" + str.C_Str());
-      texture.type = typeName;
-      texture.path = str.C_Str();
-      textures.push_back(texture);
-      loadedTextures.push_back(texture);
-    }
+    textures.push_back({ typeName, str.C_Str() });
   }
-  return textures;
+}
+
+// addTexture has already acquired every texture in data.textures, at the same index in
+// loadedTextures, so a mesh's are looked up there rather than through the cache again
+MeshTexture Model::materialTexture(const ModelData& data, const TextureRef& ref) {
+  for (uint i = 0; i < data.textures.size() && i < loadedTextures.size(); i++)
+    if (data.textures[i].path == ref.path) return { loadedTextures[i], ref.type };
+  return { TextureCache::shared().find(directory + "/" + ref.path), ref.type };
 }
 
 #endif /* MODEL_H */
@@ -0,0 +1,192 @@
+#ifndef MODELSTREAMER_H
+#define MODELSTREAMER_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include "model.h"
+#include "threadPool.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define MODEL_STREAMER_COROUTINES
+#endif
+
+/*
+ * loads models without blocking the frame
+ *
+ * load() hands back an empty Model straight away and imports it (mesh cache, obj
+ * parser or assimp) on the thread pool, with each texture decoded as its own job.
+ * finished imports wait in a queue until update(), called once a frame on the gl
+ * thread, uploads them one texture or mesh at a time until the frame's budget is
+ * spent. until then the model isn't resident and Prop draws a placeholder for it
+ */
+
+#define DEFAULT_UPLOAD_BUDGET_MS 2.0
+
+class ModelStreamer {
+  public:
+    ModelStreamer(ThreadPool& pool = ThreadPool::shared());
+
+    ModelStreamer(const ModelStreamer&) = delete;
+    ModelStreamer& operator=(const ModelStreamer&) = delete;
+
+    std::shared_ptr<Model> load(std::string path, VertexLayout layout = VERTEX_LAYOUT_FLOAT);
+
+    // gl thread, once a frame
+    void update(double budgetMilliseconds = DEFAULT_UPLOAD_BUDGET_MS);
+
+    // models handed out by load() that aren't resident yet
+    uint pending() const;
+
+#ifdef MODEL_STREAMER_COROUTINES
+    // `co_await streamer.resident(model)` resumes on the gl thread, inside update(), once the model is resident
+    struct ResidentAwaiter {
+      ModelStreamer*         streamer;
+      std::shared_ptr<Model> model;
+
+      bool await_ready() const { return model->isResident(); }
+      void await_suspend(std::coroutine_handle<> handle) { streamer->_waiting.push_back({ model, handle }); }
+      std::shared_ptr<Model> await_resume() const { return model; }
+    };
+
+    ResidentAwaiter resident(std::shared_ptr<Model> model);
+#endif
+
+  private:
+    struct Job {
+      std::shared_ptr<Model> model;
+      ModelData              data;
+      VertexLayout           layout   = VERTEX_LAYOUT_FLOAT;
+      bool                   imported = false;
+      bool                   started  = false;
+      uint                   nextTexture = 0;
+      uint                   nextMesh    = 0;
+      std::atomic<uint>      decodesLeft;
+    };
+
+    // outlives the streamer so jobs still running on the pool have somewhere to report to
+    struct ReadyQueue {
+      std::mutex                       mutex;
+      std::deque<std::shared_ptr<Job>> jobs;
+
+      void push(std::shared_ptr<Job> job);
+    };
+
+    ThreadPool&                      _pool;
+    std::shared_ptr<ReadyQueue>      _ready;
+    std::deque<std::shared_ptr<Job>> _uploading;
+    uint                             _pending;
+
+#ifdef MODEL_STREAMER_COROUTINES
+    struct Waiter {
+      std::shared_ptr<Model>  model;
+      std::coroutine_handle<> handle;
+    };
+    std::vector<Waiter> _waiting;
+#endif
+
+    static void import(std::shared_ptr<Job> job, std::shared_ptr<ReadyQueue> ready, ThreadPool& pool);
+};
+
+void ModelStreamer::ReadyQueue::push(std::shared_ptr<Job> job) {
+  std::lock_guard<std::mutex> lock(mutex);
+  jobs.push_back(job);
+}
+
+ModelStreamer::ModelStreamer(ThreadPool& pool)
+  : _pool(pool), _ready(std::make_shared<ReadyQueue>()), _pending(0) {
+}
+
+std::shared_ptr<Model> ModelStreamer::load(std::string path, VertexLayout layout) {
+  std::shared_ptr<Job> job = std::make_shared<Job>();
+  job->model = std::make_shared<Model>();
+  job->data.path = path;
+  job->layout = layout;
+  _pending++;
+
+  std::shared_ptr<ReadyQueue> ready = _ready;
+  ThreadPool& pool = _pool;
+  _pool.submit([job, ready, &pool]() { import(job, ready, pool); });
+
+  return job->model;
+}
+
+// pool thread: import, then fan the texture decodes out as their own jobs so a
+// model with many textures uses every worker, the last decode to finish queues the upload
+void ModelStreamer::import(std::shared_ptr<Job> job, std::shared_ptr<ReadyQueue> ready, ThreadPool& pool) {
+  job->imported = Model::import(job->data.path, job->data, job->layout);
+
+  uint textureCount = job->data.textures.size();
+  if (!job->imported || textureCount == 0) {
+    ready->push(job);
+    return;
+  }
+
+  job->data.images.resize(textureCount);
+  job->decodesLeft = textureCount;
+  for (uint i = 0; i < textureCount; i++) {
+    pool.submit([job, ready, i]() {
+      Model::decodeTexture(job->data, i);
+      if (--job->decodesLeft == 0) ready->push(job);
+    });
+  }
+}
+
+void ModelStreamer::update(double budgetMilliseconds) {
+  auto start = std::chrono::steady_clock::now();
+
+  {
+    std::lock_guard<std::mutex> lock(_ready->mutex);
+    while (!_ready->jobs.empty()) {
+      _uploading.push_back(_ready->jobs.front());
+      _ready->jobs.pop_front();
+    }
+  }
+
+  while (!_uploading.empty()) {
+    Job& job = *_uploading.front();
+
+    if (!job.started) {
+      job.started = true;
+      if (job.imported) job.model->begin(job.data);
+    }
+
+    if (job.imported && job.nextTexture < job.data.textures.size()) {
+      job.model->addTexture(job.data, job.nextTexture++);
+    } else if (job.imported && job.nextMesh < job.data.meshes.size()) {
+      job.model->addMesh(job.data, job.nextMesh++);
+    } else {
+      job.model->finish();
+      _uploading.pop_front();
+      _pending--;
+    }
+
+    // always make some progress, then stop as soon as the frame's budget is gone
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (elapsed >= budgetMilliseconds) break;
+  }
+
+#ifdef MODEL_STREAMER_COROUTINES
+  std::vector<Waiter> waiting;
+  waiting.swap(_waiting);
+  for (Waiter& waiter : waiting) {
+    if (waiter.model->isResident()) waiter.handle.resume();
+    else                            _waiting.push_back(waiter);
+  }
+#endif
+}
+
+uint ModelStreamer::pending() const {
+  return _pending;
+}
+
+#ifdef MODEL_STREAMER_COROUTINES
+ModelStreamer::ResidentAwaiter ModelStreamer::resident(std::shared_ptr<Model> model) {
+  return { this, model };
+}
+#endif
+
+#endif /* MODELSTREAMER_H */
@@ -0,0 +1,503 @@
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include <vector>
+#include <string>
+#include <future>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "mappedFile.h"
+#include "threadPool.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * wavefront obj/mtl loader for the blender exports in assets/
+ *
+ * the file is mapped and cut into line-aligned chunks that are parsed on the
+ * shared ThreadPool, each chunk collecting its own v/vt/vn arrays and triangulated
+ * faces. a load that's already a pool job (ModelStreamer's) parses on its own
+ * thread. the chunks are then stitched together in order and every distinct
+ * v/vt/vn corner becomes one Vertex, so the output matches what processMesh
+ * builds from assimp, minus the duplicate vertices
+ */
+
+#define OBJ_MIN_CHUNK_SIZE (256 * 1024)
+
+// Corner::local bits, for indices written relative (negative) that are still a signed offset
+// from their chunk's first element. they can reach back into earlier chunks
+#define OBJ_LOCAL_V     1
+#define OBJ_LOCAL_VT    2
+#define OBJ_LOCAL_VN    4
+// a relative index reaching before the start of the file, always out of range
+#define OBJ_BAD_INDEX   (UINT32_MAX - 1)
+
+class ObjLoader {
+  public:
+    ObjLoader(std::string path);
+
+    // chunkCount is how many pieces the file is parsed in, 0 picks from its size and the cores
+    bool load(uint chunkCount = 0);
+
+    std::vector<MeshData> meshes;
+    // every mtl file the obj names, as opened, whether or not it was there
+    std::vector<std::string> materialLibraries;
+
+  private:
+    // vt and vn are UINT32_MAX when the face leaves them out
+    struct Corner {
+      uint    v, vt, vn;
+      uint8_t local;
+    };
+
+    // triangles from `firstTriangle` on use `material`, until the next group starts
+    struct Group {
+      uint        firstTriangle;
+      std::string material;
+    };
+
+    struct Chunk {
+      const char* begin;
+      const char* end;
+
+      std::vector<glm::vec3> positions;
+      std::vector<glm::vec2> texCoords;
+      std::vector<glm::vec3> normals;
+      std::vector<Corner>    corners;
+      std::vector<Group>     groups;
+      std::vector<std::string> materialLibraries;
+    };
+
+    // the v/vt/vn triple itself is the key, all 96 bits of it
+    struct CornerHash {
+      size_t operator()(const Corner& c) const {
+        uint64_t h = (uint64_t)c.v * 0x9e3779b97f4a7c15ull ^ (uint64_t)c.vt * 0xc2b2ae3d27d4eb4full ^ (uint64_t)c.vn * 0x165667b19e3779f9ull;
+        return h ^ (h >> 29);
+      }
+    };
+    struct CornerEqual {
+      bool operator()(const Corner& a, const Corner& b) const { return a.v == b.v && a.vt == b.vt && a.vn == b.vn; }
+    };
+    typedef std::unordered_map<Corner, uint, CornerHash, CornerEqual> CornerLookup;
+
+    struct Material {
+      std::vector<TextureRef> textures;
+    };
+
+    std::string _path;
+    std::string _directory;
+    std::unordered_map<std::string, Material> _materials;
+
+    void parseChunk(Chunk& chunk);
+    void loadMaterialLibrary(std::string file);
+};
+
+ObjLoader::ObjLoader(std::string path)
+  : _path(path), _directory(path.substr(0, path.find_last_of('/'))) {
+}
+
+static inline bool objIsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* objSkipSpace(const char* p, const char* end) {
+  while (p < end && objIsSpace(*p)) p++;
+  return p;
+}
+
+static inline const char* objLineEnd(const char* p, const char* end) {
+#ifdef __SSE2__
+  const __m128i newline = _mm_set1_epi8('\n');
+  while (p + 16 <= end) {
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), newline));
+    if (mask) return p + __builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+  while (p < end && *p != '\n') p++;
+  return p;
+}
+
+// number of leading decimal digits in p, up to 8 when the sse path is taken
+static inline int objDigitRun(const char* p, const char* end) {
+#ifdef __SSE2__
+  if (p + 16 <= end) {
+    __m128i chars  = _mm_loadu_si128((const __m128i*)p);
+    __m128i shifted = _mm_sub_epi8(chars, _mm_set1_epi8('0' + (char)128));
+    __m128i nondigit = _mm_cmpgt_epi8(shifted, _mm_set1_epi8(-128 + 9));
+    int mask = _mm_movemask_epi8(nondigit) | 0x10000;
+    int run = __builtin_ctz(mask);
+    return run > 8 ? 8 : run;
+  }
+#endif
+  int run = 0;
+  while (p + run < end && run < 8 && (unsigned)(p[run] - '0') < 10) run++;
+  return run;
+}
+
+// value of the first `count` (<= 8) digits at p
+static inline uint32_t objDigitValue(const char* p, int count) {
+#ifdef __SSE2__
+  if (count == 8) {
+    // 8 ascii digits -> 4 two-digit -> 2 four-digit values with multiply-adds
+    __m128i digits = _mm_sub_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_set1_epi8('0'));
+    __m128i wide   = _mm_unpacklo_epi8(digits, _mm_setzero_si128());
+    __m128i pairs  = _mm_madd_epi16(wide, _mm_set_epi16(1, 10, 1, 10, 1, 10, 1, 10));
+    __m128i packed = _mm_packs_epi32(pairs, pairs);
+    __m128i quads  = _mm_madd_epi16(packed, _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100));
+    uint32_t hi = _mm_cvtsi128_si32(quads);
+    uint32_t lo = _mm_cvtsi128_si32(_mm_srli_si128(quads, 4));
+    return hi * 10000 + lo;
+  }
+#endif
+  uint32_t value = 0;
+  for (int i = 0; i < count; i++) value = value * 10 + (p[i] - '0');
+  return value;
+}
+
+static const double objPow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// parses [-+]digits[.digits][e[-+]digits], enough for anything blender writes
+static const char* objParseFloat(const char* p, const char* end, float& out) {
+  p = objSkipSpace(p, end);
+
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int significant = 0;
+
+  // 18 digits always fit in the mantissa, anything past that is below float precision anyway
+  for (int run; (run = objDigitRun(p, end)) > 0; p += run) {
+    if (significant + run <= 18) {
+      mantissa = mantissa * (uint64_t)objPow10[run] + objDigitValue(p, run);
+      significant += run;
+    } else {
+      exponent += run;
+    }
+  }
+
+  if (p < end && *p == '.') {
+    p++;
+    for (int run; (run = objDigitRun(p, end)) > 0; p += run) {
+      if (significant + run <= 18) {
+        mantissa = mantissa * (uint64_t)objPow10[run] + objDigitValue(p, run);
+        significant += run;
+        exponent -= run;
+      }
+    }
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negativeExponent = false;
+    if (p < end && (*p == '-' || *p == '+')) negativeExponent = *p++ == '-';
+    int e = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) e = e * 10 + (*p++ - '0');
+    exponent += negativeExponent ? -e : e;
+  }
+
+  double value = (double)mantissa;
+  if      (exponent < 0)  value /= exponent >= -22 ? objPow10[-exponent] : std::pow(10.0, -exponent);
+  else if (exponent > 0)  value *= exponent <=  22 ? objPow10[exponent]  : std::pow(10.0, exponent);
+
+  out = negative ? -(float)value : (float)value;
+  return p;
+}
+
+static const char* objParseIndex(const char* p, const char* end, int& out) {
+  bool negative = false;
+  if (p < end && *p == '-') { negative = true; p++; }
+
+  int value = 0;
+  while (p < end && (unsigned)(*p - '0') < 10) value = value * 10 + (*p++ - '0');
+
+  out = negative ? -value : value;
+  return p;
+}
+
+// turns an obj index (1-based, or negative for "from the end") into a 0-based one,
+// negative ones are resolved against this chunk, setting `bit` in local, and fixed up when
+// the chunks are merged
+static inline uint objResolveIndex(int index, uint localCount, uint8_t& local, uint8_t bit) {
+  if (index > 0)  return (uint)(index - 1);
+  if (index < 0) {
+    local |= bit;
+    return (uint)(int32_t)((int64_t)localCount + index);
+  }
+  return 0;
+}
+
+// a relative index from objResolveIndex made absolute, base being how many came before its chunk
+static inline uint objStitchIndex(uint index, bool local, uint base) {
+  if (!local) return index;
+  // negative when it reaches back past the chunk's start
+  int64_t absolute = (int64_t)base + (int32_t)index;
+  return absolute < 0 ? OBJ_BAD_INDEX : (uint)absolute;
+}
+
+static inline bool objKeyword(const char* p, const char* end, const char* word) {
+  size_t length = std::strlen(word);
+  return p + length <= end && std::memcmp(p, word, length) == 0 && (p + length == end || objIsSpace(p[length]));
+}
+
+void ObjLoader::parseChunk(Chunk& chunk) {
+  const char* p   = chunk.begin;
+  const char* end = chunk.end;
+
+  std::vector<Corner> face;
+
+  while (p < end) {
+    const char* lineEnd = objLineEnd(p, end);
+    const char* q = objSkipSpace(p, lineEnd);
+
+    if (q + 1 < lineEnd && q[0] == 'v') {
+      if (objIsSpace(q[1])) {
+        glm::vec3 v;
+        q = objParseFloat(q + 1, lineEnd, v.x);
+        q = objParseFloat(q, lineEnd, v.y);
+        q = objParseFloat(q, lineEnd, v.z);
+        chunk.positions.push_back(v);
+      } else if (q[1] == 't') {
+        glm::vec2 vt;
+        q = objParseFloat(q + 2, lineEnd, vt.x);
+        q = objParseFloat(q, lineEnd, vt.y);
+        chunk.texCoords.push_back(vt);
+      } else if (q[1] == 'n') {
+        glm::vec3 vn;
+        q = objParseFloat(q + 2, lineEnd, vn.x);
+        q = objParseFloat(q, lineEnd, vn.y);
+        q = objParseFloat(q, lineEnd, vn.z);
+        chunk.normals.push_back(vn);
+      }
+    } else if (q + 1 < lineEnd && q[0] == 'f' && objIsSpace(q[1])) {
+      face.clear();
+      q = objSkipSpace(q + 1, lineEnd);
+      while (q < lineEnd) {
+        int v = 0, vt = 0, vn = 0;
+        q = objParseIndex(q, lineEnd, v);
+        if (q < lineEnd && *q == '/') {
+          q++;
+          if (q < lineEnd && *q != '/') q = objParseIndex(q, lineEnd, vt);
+          if (q < lineEnd && *q == '/') q = objParseIndex(q + 1, lineEnd, vn);
+        }
+
+        Corner corner;
+        corner.local = 0;
+        corner.v  = objResolveIndex(v,  chunk.positions.size(), corner.local, OBJ_LOCAL_V);
+        corner.vt = vt ? objResolveIndex(vt, chunk.texCoords.size(), corner.local, OBJ_LOCAL_VT) : UINT32_MAX;
+        corner.vn = vn ? objResolveIndex(vn, chunk.normals.size(),   corner.local, OBJ_LOCAL_VN) : UINT32_MAX;
+        face.push_back(corner);
+
+        q = objSkipSpace(q, lineEnd);
+      }
+
+      // fan triangulation, same as aiProcess_Triangulate for the convex faces blender writes
+      for (uint i = 2; i < face.size(); i++) {
+        chunk.corners.push_back(face[0]);
+        chunk.corners.push_back(face[i - 1]);
+        chunk.corners.push_back(face[i]);
+      }
+    } else if (objKeyword(q, lineEnd, "usemtl")) {
+      Group group;
+      group.firstTriangle = chunk.corners.size() / 3;
+      const char* name = objSkipSpace(q + 6, lineEnd);
+      const char* nameEnd = lineEnd;
+      while (nameEnd > name && objIsSpace(nameEnd[-1])) nameEnd--;
+      group.material.assign(name, nameEnd);
+      chunk.groups.push_back(group);
+    } else if (objKeyword(q, lineEnd, "mtllib")) {
+      const char* name = objSkipSpace(q + 6, lineEnd);
+      const char* nameEnd = lineEnd;
+      while (nameEnd > name && objIsSpace(nameEnd[-1])) nameEnd--;
+      chunk.materialLibraries.push_back(std::string(name, nameEnd));
+    }
+
+    p = lineEnd + 1;
+  }
+}
+
+void ObjLoader::loadMaterialLibrary(std::string file) {
+  materialLibraries.push_back(_directory + "/" + file);
+  MappedFile mtl;
+  if (!mtl.open(materialLibraries.back())) {
+    std::cout << "WARNING::OBJLOADER::MISSING_MTL '" << file << "'" << std::endl;
+    return;
+  }
+
+  const char* p   = (const char*)mtl.data();
+  const char* end = p + mtl.size();
+  Material* current = nullptr;
+
+  while (p < end) {
+    const char* lineEnd = objLineEnd(p, end);
+    const char* q = objSkipSpace(p, lineEnd);
+    const char* valueEnd = lineEnd;
+    while (valueEnd > q && objIsSpace(valueEnd[-1])) valueEnd--;
+
+    if (objKeyword(q, lineEnd, "newmtl")) {
+      current = &_materials[std::string(objSkipSpace(q + 6, valueEnd), valueEnd)];
+    } else if (current && objKeyword(q, lineEnd, "map_Kd")) {
+      TextureRef ref;
+      ref.type = "texture_diffuse";
+      ref.path.assign(objSkipSpace(q + 6, valueEnd), valueEnd);
+      current->textures.push_back(ref);
+    } else if (current && objKeyword(q, lineEnd, "map_Ks")) {
+      TextureRef ref;
+      ref.type = "texture_specular";
+      ref.path.assign(objSkipSpace(q + 6, valueEnd), valueEnd);
+      current->textures.push_back(ref);
+    }
+
+    p = lineEnd + 1;
+  }
+}
+
+bool ObjLoader::load(uint chunkCount) {
+  MappedFile file;
+  if (!file.open(_path)) {
+    std::cout << "ERROR::OBJLOADER::FAILED_TO_OPEN '" << _path << "'" << std::endl;
+    return false;
+  }
+
+  const char* data = (const char*)file.data();
+  const char* end  = data + file.size();
+
+  // cut the file into roughly equal chunks, each ending on a line break. the pool's workers
+  // take all but the first, which this thread parses
+  ThreadPool& pool = ThreadPool::shared();
+  uint threads = ThreadPool::onWorker() ? 1 : pool.size() + 1;
+  if (chunkCount == 0) chunkCount = std::max<size_t>(1, std::min<size_t>(threads, file.size() / OBJ_MIN_CHUNK_SIZE));
+
+  std::vector<Chunk> chunks(chunkCount);
+  const char* p = data;
+  for (uint i = 0; i < chunkCount; i++) {
+    const char* chunkEnd = (i + 1 == chunkCount) ? end : data + file.size() * (i + 1) / chunkCount;
+    if (chunkEnd < p) chunkEnd = p;
+    chunkEnd = objLineEnd(chunkEnd, end);
+    if (chunkEnd < end) chunkEnd++;
+
+    chunks[i].begin = p;
+    chunks[i].end   = chunkEnd;
+    p = chunkEnd;
+  }
+
+  std::vector<std::future<void>> pending;
+  if (ThreadPool::onWorker()) {
+    for (Chunk& chunk : chunks) parseChunk(chunk);
+  } else {
+    for (uint i = 1; i < chunkCount; i++)
+      pending.push_back(pool.submit([this, &chunks, i]() { parseChunk(chunks[i]); }));
+    parseChunk(chunks[0]);
+  }
+  for (std::future<void>& chunk : pending) chunk.get();
+
+  // stitch the chunks back together
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> texCoords;
+  std::vector<glm::vec3> normals;
+  for (Chunk& chunk : chunks) {
+    uint basePositions = positions.size();
+    uint baseTexCoords = texCoords.size();
+    uint baseNormals   = normals.size();
+
+    for (Corner& corner : chunk.corners) {
+      corner.v  = objStitchIndex(corner.v,  corner.local & OBJ_LOCAL_V,  basePositions);
+      corner.vt = objStitchIndex(corner.vt, corner.local & OBJ_LOCAL_VT, baseTexCoords);
+      corner.vn = objStitchIndex(corner.vn, corner.local & OBJ_LOCAL_VN, baseNormals);
+      corner.local = 0;
+    }
+
+    positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+    texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+    normals.insert(normals.end(),     chunk.normals.begin(),   chunk.normals.end());
+
+    for (const std::string& library : chunk.materialLibraries)
+      loadMaterialLibrary(library);
+  }
+
+  // one mesh per material, in the order the materials first appear
+  std::unordered_map<std::string, uint> meshForMaterial;
+  std::vector<CornerLookup> vertexLookup;
+  std::string material;
+  uint meshIndex = UINT32_MAX;
+
+  meshes.clear();
+  for (Chunk& chunk : chunks) {
+    uint triangles = chunk.corners.size() / 3;
+    uint group = 0;
+
+    for (uint t = 0; t < triangles; t++) {
+      while (group < chunk.groups.size() && chunk.groups[group].firstTriangle == t) {
+        material  = chunk.groups[group++].material;
+        meshIndex = UINT32_MAX;
+      }
+
+      if (meshIndex == UINT32_MAX) {
+        auto found = meshForMaterial.find(material);
+        if (found != meshForMaterial.end()) {
+          meshIndex = found->second;
+        } else {
+          meshIndex = meshes.size();
+          meshForMaterial[material] = meshIndex;
+          meshes.push_back(MeshData());
+          vertexLookup.push_back(CornerLookup());
+          vertexLookup.back().reserve(positions.size());
+
+          auto mtl = _materials.find(material);
+          if (mtl != _materials.end()) meshes.back().textures = mtl->second.textures;
+        }
+      }
+
+      MeshData& mesh = meshes[meshIndex];
+      CornerLookup& lookup = vertexLookup[meshIndex];
+
+      for (uint k = 0; k < 3; k++) {
+        const Corner& corner = chunk.corners[t * 3 + k];
+        if (corner.v >= positions.size() || (corner.vt != UINT32_MAX && corner.vt >= texCoords.size()) ||
+            (corner.vn != UINT32_MAX && corner.vn >= normals.size())) {
+          std::cout << "ERROR::OBJLOADER::INDEX_OUT_OF_RANGE '" << _path << "'" << std::endl;
+          meshes.clear();
+          return false;
+        }
+
+        auto existing = lookup.find(corner);
+        if (existing != lookup.end()) {
+          mesh.indices.push_back(existing->second);
+          continue;
+        }
+
+        Vertex vertex;
+        vertex.position  = positions[corner.v];
+        vertex.normal    = corner.vn != UINT32_MAX ? normals[corner.vn]   : glm::vec3(0.0f);
+        vertex.texCoords = corner.vt != UINT32_MAX ? texCoords[corner.vt] : glm::vec2(0.0f);
+
+        uint index = mesh.vertices.size();
+        mesh.vertices.push_back(vertex);
+        mesh.indices.push_back(index);
+        lookup[corner] = index;
+      }
+    }
+
+    // a usemtl after the chunk's last face (or in a chunk with none) holds for the next chunk's faces
+    while (group < chunk.groups.size()) {
+      material  = chunk.groups[group++].material;
+      meshIndex = UINT32_MAX;
+    }
+  }
+
+  return !meshes.empty();
+}
+
+#endif /* OBJLOADER_H */
@@ -0,0 +1,164 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <sys/types.h>
+#include "shader.h"
+#include "glState.h"
+#include "view.h"
+
+/*
+ * everything drawn in a frame is submitted here first with a 64 bit sort key, then
+ * flush() radix sorts the lot and draws it in key order
+ *
+ *   opaque       pass | shader 10 | material 14 | mesh 14 | depth 24
+ *                grouped by state, front to back inside each group so the depth test
+ *                throws away as much as it can
+ *   transparent  pass | ~depth 24 | shader 10 | material 14 | mesh 14
+ *                back to front whatever the state, blending needs it. sprites go here
+ *
+ * shader, material and mesh are gl names (program, first texture, vertex array) cut
+ * down to their field. two that share the low bits only sort together, nothing breaks.
+ * meshes share their layout's vertex array (see GeometryArena), so mesh groups by layout
+ * depth is the distance from the camera to the nearest point of the thing, as the top
+ * 24 bits of the float, which order the same way for anything positive
+ *
+ * gl thread only, renderables have to outlive the flush they were submitted to
+ */
+
+enum RenderPass {
+  RENDER_PASS_OPAQUE      = 0,
+  RENDER_PASS_TRANSPARENT = 1
+};
+
+#define RENDER_KEY_PASS_SHIFT      62
+#define RENDER_KEY_SHADER_BITS     10
+#define RENDER_KEY_MATERIAL_BITS   14
+#define RENDER_KEY_MESH_BITS       14
+#define RENDER_KEY_DEPTH_BITS      24
+
+class Renderable {
+  public:
+    virtual ~Renderable() {}
+
+    // called from RenderQueue::flush with the shader it was submitted with already in use
+    virtual void render(Shader& shader, const View& view) = 0;
+};
+
+struct RenderCommand {
+  uint64_t    key;
+  Renderable* renderable;
+  Shader*     shader;
+};
+
+struct RenderQueueStats {
+  uint commands = 0;
+  // radix passes skipped because every key had the same byte there
+  uint skippedPasses = 0;
+};
+
+class RenderQueue {
+  public:
+    void submit(RenderPass pass, Shader& shader, uint material, uint mesh, float depth, Renderable& renderable);
+    // sorts, draws everything in key order and empties the queue
+    void flush(const View& view);
+
+    size_t size() const { return _commands.size(); }
+    const RenderQueueStats& stats() const { return _stats; }
+
+    static uint64_t makeKey(RenderPass pass, uint shader, uint material, uint mesh, float depth);
+    static uint32_t quantizeDepth(float depth);
+    // lsd radix sort on the whole key, a byte at a time, stable. scratch is resized to fit
+    static void sort(std::vector<RenderCommand>& commands, std::vector<RenderCommand>& scratch, uint* skippedPasses = nullptr);
+
+  private:
+    std::vector<RenderCommand> _commands;
+    std::vector<RenderCommand> _scratch;
+    RenderQueueStats _stats;
+};
+
+static inline uint64_t renderKeyField(uint value, uint bits) {
+  return (uint64_t)(value & ((1u << bits) - 1));
+}
+
+uint32_t RenderQueue::quantizeDepth(float depth) {
+  if (!(depth > 0.0f)) return 0;
+  uint32_t bits;
+  std::memcpy(&bits, &depth, sizeof(bits));
+  // sign is 0, so the exponent and the top of the mantissa
+  return bits >> (31 - RENDER_KEY_DEPTH_BITS);
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, uint shader, uint material, uint mesh, float depth) {
+  uint64_t state = renderKeyField(shader, RENDER_KEY_SHADER_BITS);
+  state = (state << RENDER_KEY_MATERIAL_BITS) | renderKeyField(material, RENDER_KEY_MATERIAL_BITS);
+  state = (state << RENDER_KEY_MESH_BITS)     | renderKeyField(mesh, RENDER_KEY_MESH_BITS);
+  uint64_t depthBits = quantizeDepth(depth);
+  uint     stateBits = RENDER_KEY_SHADER_BITS + RENDER_KEY_MATERIAL_BITS + RENDER_KEY_MESH_BITS;
+
+  uint64_t key = (uint64_t)pass << RENDER_KEY_PASS_SHIFT;
+  if (pass == RENDER_PASS_OPAQUE)
+    return key | (state << RENDER_KEY_DEPTH_BITS) | depthBits;
+
+  uint64_t farFirst = ((1u << RENDER_KEY_DEPTH_BITS) - 1) - depthBits;
+  return key | (farFirst << stateBits) | state;
+}
+
+void RenderQueue::submit(RenderPass pass, Shader& shader, uint material, uint mesh, float depth, Renderable& renderable) {
+  _commands.push_back({ makeKey(pass, shader.ID, material, mesh, depth), &renderable, &shader });
+}
+
+void RenderQueue::sort(std::vector<RenderCommand>& commands, std::vector<RenderCommand>& scratch, uint* skippedPasses) {
+  size_t count = commands.size();
+  if (count < 2) return;
+  scratch.resize(count);
+
+  RenderCommand* from = commands.data();
+  RenderCommand* to   = scratch.data();
+  for (uint shift = 0; shift < 64; shift += 8) {
+    size_t offsets[256] = {};
+    for (size_t i = 0; i < count; i++) offsets[(from[i].key >> shift) & 0xff]++;
+
+    // every key the same here, the pass would only copy
+    if (offsets[(from[0].key >> shift) & 0xff] == count) {
+      if (skippedPasses) (*skippedPasses)++;
+      continue;
+    }
+
+    size_t total = 0;
+    for (size_t& offset : offsets) {
+      size_t bucket = offset;
+      offset = total;
+      total += bucket;
+    }
+    for (size_t i = 0; i < count; i++) to[offsets[(from[i].key >> shift) & 0xff]++] = from[i];
+    std::swap(from, to);
+  }
+
+  if (from != commands.data()) std::memcpy(commands.data(), from, count * sizeof(RenderCommand));
+}
+
+void RenderQueue::flush(const View& view) {
+  _stats = RenderQueueStats();
+  _stats.commands = _commands.size();
+  sort(_commands, _scratch, &_stats.skippedPasses);
+
+  GLState& state = GLState::shared();
+  for (const RenderCommand& command : _commands) {
+    // sorted by pass first, so this flips once when the transparent bucket starts
+    bool transparent = (command.key >> RENDER_KEY_PASS_SHIFT) == RENDER_PASS_TRANSPARENT;
+    state.setBlend(transparent);
+    state.setDepthWrite(!transparent);
+
+    command.shader->use();
+    command.renderable->render(*command.shader, view);
+  }
+  state.setBlend(false);
+  state.setDepthWrite(true);
+
+  _commands.clear();
+}
+
+#endif /* RENDERQUEUE_H */
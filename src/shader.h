@@ -2,13 +2,70 @@
 #define SHADER_H
 
 #include "glad/glad.h"
+#include <mutex>
 #include <string>
-#include <sstream>
-#include <fstream>
+#include <vector>
+#include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "mappedFile.h"
+#include "hash.h"
+#include "uniformBuffer.h"
+#include "glState.h"
+#include "loadProfiler.h"
+
+/*
+ * after linking, every active uniform is listed once with glGetActiveUniform into a flat
+ * hash table (name -> location), so no setter goes back to the driver for a location.
+ * array uniforms get an entry per element, and the bare name for element 0
+ *
+ * the blocks in uniformBuffer.h are hooked up to their binding points at link as well,
+ * their members aren't in the table, they're set through the block's buffer
+ *
+ * the per-frame path goes through Uniform handles: a name given a small id once, which
+ * each shader turns into its location the first time it's used and then just indexes.
+ * make them up front (members, statics) and keep them, no strings get built or hashed
+ * after that. the std::string setters are still there for one-off setup
+ *
+ * each entry keeps the last value set, and a setter with the same value again doesn't
+ * reach gl. uploadStats() counts what went through and what was skipped, main resets
+ * it every frame. the shadow assumes uniforms are only set through here, and only
+ * while the shader is in use, which is what glUniform needs anyway
+ */
+
+// not looked up in this shader yet, -1 is "no such uniform" and is cached too
+#define UNIFORM_UNRESOLVED -2
+
+struct UniformUploadStats {
+    uint issued  = 0;
+    uint skipped = 0;
+
+    void reset() { issued = skipped = 0; }
+};
+
+class Uniform {
+    public:
+        // the same name always gets the same id
+        Uniform(const std::string& name);
+
+        uint id() const { return _id; }
+        const std::string& name() const { return *_name; }
+
+        // how many names have been given ids so far
+        static uint count();
+
+    private:
+        uint _id;
+        const std::string* _name;
+
+        static std::mutex& registryMutex();
+        static std::unordered_map<std::string, uint>& registry();
+        static std::vector<const std::string*>& names();
+};
 
 class Shader {
     public:
@@ -16,39 +73,105 @@ class Shader {
 
         void use();
 
+        // -1 if the program has no active uniform by that name
+        GLint location(const char* name) const;
+        GLint location(const std::string& name) const;
+        GLint location(const Uniform& uniform) const;
+
         void setBool(const std::string& name, bool value) const;
         void setInt(const std::string& name, int value) const;
         void setFloat(const std::string& name, float value) const;
         void setMat4(const std::string& name, glm::mat4 value) const;
+        void setVec2(const std::string& name, glm::vec2 value) const;
         void setVec3(const std::string& name, glm::vec3 value) const;
 
+        void setBool(const Uniform& uniform, bool value) const;
+        void setInt(const Uniform& uniform, int value) const;
+        void setFloat(const Uniform& uniform, float value) const;
+        void setMat4(const Uniform& uniform, const glm::mat4& value) const;
+        void setVec2(const Uniform& uniform, glm::vec2 value) const;
+        void setVec3(const Uniform& uniform, glm::vec3 value) const;
+
         unsigned int ID;
+
+        // uploads made and skipped as unchanged since the last reset, over every shader
+        static UniformUploadStats& uploadStats();
+
+    private:
+        struct UniformEntry {
+            uint64_t    hash = 0;
+            GLint       location = -1;
+            // into _shadows, shared by names for the same location (arr and arr[0])
+            uint        shadow = 0;
+            std::string name;
+        };
+
+        // the last value sent, as raw bytes, a mat4 at most
+        struct UniformShadow {
+            bool     set = false;
+            uint32_t value[16];
+        };
+
+        // open addressing with linear probing, the size a power of two, hash 0 marks a free slot
+        std::vector<UniformEntry> _uniforms;
+        mutable std::vector<UniformShadow> _shadows;
+        // slots in _uniforms by Uniform::id, UNIFORM_UNRESOLVED until first used, -1 if missing
+        mutable std::vector<int> _resolved;
+
+        void buildUniformTable();
+        void bindUniformBlocks();
+        void addUniform(const std::string& name, GLint location, uint shadow);
+        static uint64_t uniformHash(const char* name, size_t length);
+
+        // null if the program has no such uniform
+        const UniformEntry* find(const char* name) const;
+        const UniformEntry* find(const Uniform& uniform) const;
+        // true when value differs from the shadow, which then takes it
+        bool changed(const UniformEntry* entry, const void* value, size_t size) const;
 };
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
+Uniform::Uniform(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto found = registry().emplace(name, (uint)names().size());
+    if (found.second) names().push_back(&found.first->first);
+    _id   = found.first->second;
+    _name = &found.first->first;
+}
 
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+uint Uniform::count() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    return names().size();
+}
 
-    try {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
+std::mutex& Uniform::registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
 
-        std::stringstream vShaderStream, fShaderStream;
+// node based, so the names' addresses stay put as it grows
+std::unordered_map<std::string, uint>& Uniform::registry() {
+    static std::unordered_map<std::string, uint> registry;
+    return registry;
+}
 
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
+std::vector<const std::string*>& Uniform::names() {
+    static std::vector<const std::string*> names;
+    return names;
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+    LoadAsset asset(std::string(vertexPath) + ", " + fragmentPath);
 
-        vShaderFile.close();
-        fShaderFile.close();
+    // through MappedFile so the sources can come out of the asset pack too
+    std::string vertexCode;
+    std::string fragmentCode;
+    MappedFile vShaderFile;
+    MappedFile fShaderFile;
 
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    } catch (std::ifstream::failure e) {
+    if (vShaderFile.open(vertexPath) && fShaderFile.open(fragmentPath)) {
+        vertexCode.assign((const char*)vShaderFile.data(), vShaderFile.size());
+        fragmentCode.assign((const char*)fShaderFile.data(), fShaderFile.size());
+    } else {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
     }
 
@@ -56,6 +179,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     const char* fShaderCode = fragmentCode.c_str();
 
     // compile shaders
+    LoadTimer timer(LOAD_STAGE_SHADER_COMPILE);
 
     unsigned int vertex, fragment;
     int success;
@@ -97,28 +221,204 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    buildUniformTable();
+    bindUniformBlocks();
+}
+
+void Shader::bindUniformBlocks() {
+    for (const UniformBlockBinding& block : UNIFORM_BLOCK_BINDINGS) {
+        GLuint index = glGetUniformBlockIndex(ID, block.name);
+        if (index != GL_INVALID_INDEX) glUniformBlockBinding(ID, index, block.binding);
+    }
+}
+
+void Shader::buildUniformTable() {
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    // every element of an array takes an entry, count them first so the table is sized once
+    std::vector<std::pair<std::string, GLint>> active;
+    std::vector<char> name(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+        std::string uniformName(name.data(), length);
+
+        // members of a uniform block have no location
+        GLint location = glGetUniformLocation(ID, uniformName.c_str());
+        if (location < 0) continue;
+
+        size_t bracket = uniformName.size() >= 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0
+            ? uniformName.size() - 3 : std::string::npos;
+        if (bracket == std::string::npos) {
+            active.emplace_back(uniformName, location);
+            continue;
+        }
+
+        // array elements aren't promised to be at consecutive locations, so each is asked for
+        std::string base = uniformName.substr(0, bracket);
+        active.emplace_back(base, location);
+        active.emplace_back(uniformName, location);
+        for (GLint element = 1; element < size; element++) {
+            std::string elementName = base + "[" + std::to_string(element) + "]";
+            active.emplace_back(elementName, glGetUniformLocation(ID, elementName.c_str()));
+        }
+    }
+
+    // at most half full
+    size_t capacity = 16;
+    while (capacity < active.size() * 2) capacity *= 2;
+    _uniforms.assign(capacity, UniformEntry());
+    std::unordered_map<GLint, uint> shadows;
+    for (auto& uniform : active) {
+        auto shadow = shadows.emplace(uniform.second, (uint)shadows.size());
+        addUniform(uniform.first, uniform.second, shadow.first->second);
+    }
+    _shadows.assign(shadows.size(), UniformShadow());
+}
+
+uint64_t Shader::uniformHash(const char* name, size_t length) {
+    uint64_t hash = hashBytes(name, length);
+    return hash ? hash : 1;
+}
+
+void Shader::addUniform(const std::string& name, GLint location, uint shadow) {
+    uint64_t hash = uniformHash(name.data(), name.size());
+    size_t mask = _uniforms.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        UniformEntry& entry = _uniforms[slot];
+        if (entry.hash == 0) {
+            entry.hash     = hash;
+            entry.location = location;
+            entry.shadow   = shadow;
+            entry.name     = name;
+            return;
+        }
+        if (entry.hash == hash && entry.name == name) return;
+    }
 }
 
 void Shader::use() {
-    glUseProgram(ID);
+    GLState::shared().useProgram(ID);
+}
+
+const Shader::UniformEntry* Shader::find(const char* name) const {
+    if (_uniforms.empty()) return nullptr;
+    size_t length = std::strlen(name);
+    uint64_t hash = uniformHash(name, length);
+    size_t mask = _uniforms.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const UniformEntry& entry = _uniforms[slot];
+        if (entry.hash == 0) return nullptr;
+        if (entry.hash == hash && entry.name.size() == length && std::memcmp(entry.name.data(), name, length) == 0)
+            return &entry;
+    }
+}
+
+const Shader::UniformEntry* Shader::find(const Uniform& uniform) const {
+    if (uniform.id() >= _resolved.size()) _resolved.resize(Uniform::count(), UNIFORM_UNRESOLVED);
+    int& slot = _resolved[uniform.id()];
+    if (slot == UNIFORM_UNRESOLVED) {
+        const UniformEntry* entry = find(uniform.name().c_str());
+        slot = entry ? (int)(entry - _uniforms.data()) : -1;
+    }
+    return slot < 0 ? nullptr : &_uniforms[slot];
+}
+
+bool Shader::changed(const UniformEntry* entry, const void* value, size_t size) const {
+    if (!entry) return false;
+    UniformShadow& shadow = _shadows[entry->shadow];
+    if (shadow.set && std::memcmp(shadow.value, value, size) == 0) {
+        uploadStats().skipped++;
+        return false;
+    }
+    std::memcpy(shadow.value, value, size);
+    shadow.set = true;
+    uploadStats().issued++;
+    return true;
+}
+
+UniformUploadStats& Shader::uploadStats() {
+    static UniformUploadStats stats;
+    return stats;
+}
+
+GLint Shader::location(const char* name) const {
+    const UniformEntry* entry = find(name);
+    return entry ? entry->location : -1;
+}
+
+GLint Shader::location(const std::string& name) const {
+    return location(name.c_str());
+}
+
+GLint Shader::location(const Uniform& uniform) const {
+    const UniformEntry* entry = find(uniform);
+    return entry ? entry->location : -1;
 }
 
 void Shader::setBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    // the same int glUniform1i gets, so it shadows like setInt
+    setInt(name, (int)value);
 }
 
 void Shader::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    const UniformEntry* entry = find(name.c_str());
+    if (changed(entry, &value, sizeof(value))) glUniform1i(entry->location, value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    const UniformEntry* entry = find(name.c_str());
+    if (changed(entry, &value, sizeof(value))) glUniform1f(entry->location, value);
 }
 
 void Shader::setMat4(const std::string& name, glm::mat4 value) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    const UniformEntry* entry = find(name.c_str());
+    if (changed(entry, &value, sizeof(value))) glUniformMatrix4fv(entry->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setVec2(const std::string& name, glm::vec2 value) const {
+    const UniformEntry* entry = find(name.c_str());
+    if (changed(entry, &value, sizeof(value))) glUniform2fv(entry->location, 1, glm::value_ptr(value));
 }
 
 void Shader::setVec3(const std::string& name, glm::vec3 value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value)); }
+    const UniformEntry* entry = find(name.c_str());
+    if (changed(entry, &value, sizeof(value))) glUniform3fv(entry->location, 1, glm::value_ptr(value));
+}
+
+void Shader::setBool(const Uniform& uniform, bool value) const {
+    // the same int glUniform1i gets, so it shadows like setInt
+    setInt(uniform, (int)value);
+}
+
+void Shader::setInt(const Uniform& uniform, int value) const {
+    const UniformEntry* entry = find(uniform);
+    if (changed(entry, &value, sizeof(value))) glUniform1i(entry->location, value);
+}
+
+void Shader::setFloat(const Uniform& uniform, float value) const {
+    const UniformEntry* entry = find(uniform);
+    if (changed(entry, &value, sizeof(value))) glUniform1f(entry->location, value);
+}
+
+void Shader::setMat4(const Uniform& uniform, const glm::mat4& value) const {
+    const UniformEntry* entry = find(uniform);
+    if (changed(entry, &value, sizeof(value))) glUniformMatrix4fv(entry->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setVec2(const Uniform& uniform, glm::vec2 value) const {
+    const UniformEntry* entry = find(uniform);
+    if (changed(entry, &value, sizeof(value))) glUniform2fv(entry->location, 1, glm::value_ptr(value));
+}
+
+void Shader::setVec3(const Uniform& uniform, glm::vec3 value) const {
+    const UniformEntry* entry = find(uniform);
+    if (changed(entry, &value, sizeof(value))) glUniform3fv(entry->location, 1, glm::value_ptr(value));
+}
+
 #endif // SHADER_H
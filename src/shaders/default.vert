@@ -2,19 +2,46 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// locations 3 to 7 are instanced.vert's
+
+// FrameData in uniformBuffer.h
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// VERTEX_LAYOUT_PACKED meshes come in as normalised shorts, see PackedVertex in mesh.h
+uniform bool packedVertices;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+uniform vec2 texCoordScale;
+uniform vec2 texCoordOffset;
 
 out vec3 ourColor;
 out vec3 normal;
 out vec3 fragPos;
 out vec2 texCoords;
+// instanced.vert's per-instance tint, always white here
+out vec4 tint;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return n;
+}
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
-    normal = mat3(transpose(inverse(model))) * normalize(aNormal);
-    fragPos = vec3(model * vec4(aPos, 1.0));
-    texCoords = aTexCoords;
+    vec3 position = positionOffset + positionScale * aPos;
+    vec3 vertexNormal = packedVertices ? octDecode(aNormal.xy) : aNormal;
+
+    gl_Position = projection * view * model * vec4(position, 1.0f);
+    normal = mat3(transpose(inverse(model))) * normalize(vertexNormal);
+    fragPos = vec3(model * vec4(position, 1.0));
+    texCoords = texCoordOffset + texCoordScale * aTexCoords;
+    tint = vec4(1.0);
 }
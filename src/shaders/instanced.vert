@@ -0,0 +1,49 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per instance, InstanceData in mesh.h: the model matrix's columns, then the tint
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in vec4 aTint;
+
+// FrameData in uniformBuffer.h
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// VERTEX_LAYOUT_PACKED meshes come in as normalised shorts, see PackedVertex in mesh.h
+uniform bool packedVertices;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+uniform vec2 texCoordScale;
+uniform vec2 texCoordOffset;
+
+out vec3 ourColor;
+out vec3 normal;
+out vec3 fragPos;
+out vec2 texCoords;
+out vec4 tint;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return n;
+}
+
+void main() {
+    vec3 position = positionOffset + positionScale * aPos;
+    vec3 vertexNormal = packedVertices ? octDecode(aNormal.xy) : aNormal;
+
+    // instances are rigid with a uniform scale, so the model matrix turns normals right
+    // without an inverse per vertex
+    vec4 worldPos = aModel * vec4(position, 1.0);
+    gl_Position = projection * view * worldPos;
+    normal = normalize(mat3(aModel) * vertexNormal);
+    fragPos = vec3(worldPos);
+    texCoords = texCoordOffset + texCoordScale * aTexCoords;
+    tint = aTint;
+}
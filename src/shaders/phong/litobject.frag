@@ -7,60 +7,60 @@ struct Material {
   float shininess;
 };
 
+/* laid out for std140, each vec3 shares its 16 bytes with the float after it.
+   the *LightData structs in uniformBuffer.h mirror these */
 struct DirectionalLight {
-  vec3 direction;
+  vec3 direction; float _padding0;
 
-  vec3 ambient;
-  vec3 diffuse;
-  vec3 specular;
+  vec3 ambient;   float _padding1;
+  vec3 diffuse;   float _padding2;
+  vec3 specular;  float _padding3;
 };
 
 struct PointLight {
-  vec3 position;
+  /* attentuation alongside */
+  vec3 position;  float constant;
 
-  vec3 ambient;
-  vec3 diffuse;
-  vec3 specular;
-
-  /* attentuation */
-  float constant;
-  float linear;
-  float quadratic;
+  vec3 ambient;   float linear;
+  vec3 diffuse;   float quadratic;
+  vec3 specular;  float _padding;
 };
 
 struct SpotLight {
-  vec3 position;
-  vec3 direction;
-  float innerCone;
-  float outerCone;
-
-  vec3 ambient;
-  vec3 diffuse;
-  vec3 specular;
-
-  /* attentuation */
-  float constant;
-  float linear;
-  float quadratic;
+  vec3 position;  float innerCone;
+  vec3 direction; float outerCone;
+
+  /* attentuation alongside */
+  vec3 ambient;   float constant;
+  vec3 diffuse;   float linear;
+  vec3 specular;  float quadratic;
 };
 
-uniform vec3       viewPos;
-uniform Material   material;
+layout (std140) uniform FrameData {
+  mat4 view;
+  mat4 projection;
+  vec3 viewPos;
+};
 
-uniform DirectionalLight dirLight;
+/* MAX_SPOT_LIGHTS and MAX_POINT_LIGHTS in uniformBuffer.h */
+layout (std140) uniform LightData {
+  DirectionalLight dirLight;
+  SpotLight flashlight;
 
-uniform bool usingFlashlight;
-uniform SpotLight flashlight;
+  int usingFlashlight;
+  int spotLightAmount;
+  int pointLightAmount;
 
-uniform int spotLightAmount; 
-uniform SpotLight spotLights[16];
+  SpotLight spotLights[64];
+  PointLight pointLights[64];
+};
 
-uniform int pointLightAmount;
-uniform PointLight pointLights[16];
+uniform Material   material;
 
 in vec3 normal;
 in vec3 fragPos;
 in vec2 texCoords;
+in vec4 tint;
 
 out vec4 fragColor;
 
@@ -151,7 +151,7 @@ void main() {
 //    for (int i = 0; i < pointLightAmount; i++)
 //      result += calcPointLighting(pointLights[i], normal, fragPos, viewDir);
 
-    if (usingFlashlight) result += calcSpotLighting(flashlight, normal, viewDir);
+    if (usingFlashlight != 0) result += calcSpotLighting(flashlight, normal, viewDir);
 
-    gl_FragColor = vec4(result, 1.0f);
+    gl_FragColor = vec4(result * tint.rgb, 1.0f);
 }
@@ -1,25 +1,43 @@
 #ifndef SPRITE_H
 #define SPRITE_H
 
+#include <memory>
+#include <glm/gtc/matrix_transform.hpp>
 #include "mesh.h"
+#include "assetManager.h"
+#include "renderQueue.h"
+#include "entity/entity.h"
 #ifndef STB_IMAGE_H
 #define STB_IMAGE_H
 #include "stb_image.h"
 #endif
 
-class Sprite {
+class Sprite : public Entity, public Renderable {
   public:
-    Sprite(std::string texturePath, glm::vec3 color);
+    Sprite(std::string texturePath, glm::vec3 color, glm::vec3 position = glm::vec3(0.0f));
 
     void draw(Shader& shader);
 
+    // queued as transparent, back to front with everything else blended
+    void submit(RenderQueue& queue, Shader& shader, const View& view);
+    // draws at the sprite's position
+    void render(Shader& shader, const View& view) override;
+
   private:
+    // the mesh holds on to the texture
     Mesh _mesh;
 
     glm::vec3 _color;
+
+    static Mesh quadMesh(std::string texturePath);
 };
 
-Sprite::Sprite(std::string texturePath, glm::vec3 color) {
+Sprite::Sprite(std::string texturePath, glm::vec3 color, glm::vec3 position)
+  : Entity(position, glm::vec3(0.0f, 0.0f, -1.0f)), _mesh(quadMesh(texturePath)), _color(color) {
+}
+
+Mesh Sprite::quadMesh(std::string texturePath) {
+    LoadAsset asset(texturePath);
     Vertex v0;
     v0.position  = glm::vec3(-1.0f, -1.0f, 0.0f);
     v0.texCoords = glm::vec2(0.0f, 0.0f);
@@ -45,21 +63,27 @@ Sprite::Sprite(std::string texturePath, glm::vec3 color) {
     std::vector<uint> indices;
     indices.insert(indices.end(), { 0, 1, 2, 2, 3, 0 });
 
-    Texture texture;
-    texture.id = loadTexture(texturePath);
-    texture.type = "texture_diffuse";
-    texture.path = texturePath;
-
-    std::vector<Texture> textures;
-    textures.push_back(texture);
+    std::vector<MeshTexture> textures;
+    textures.push_back({ AssetManager::shared().texture(texturePath), "texture_diffuse" });
 
-    _mesh = Mesh(quad, indices, textures);
-    _color = color;
+    return Mesh(std::move(quad), std::move(indices), std::move(textures));
 }
 
 void Sprite::draw(Shader& shader) {
-    shader.setVec3("color", _color);
+    static const Uniform color("color");
+    shader.setVec3(color, _color);
     _mesh.draw(shader);
 }
 
+void Sprite::submit(RenderQueue& queue, Shader& shader, const View& view) {
+    float depth = glm::length(_position - view.position);
+    queue.submit(RENDER_PASS_TRANSPARENT, shader, _mesh.firstTexture(), _mesh.vertexArray(), depth, *this);
+}
+
+void Sprite::render(Shader& shader, const View& /*view*/) {
+    static const Uniform model("model");
+    shader.setMat4(model, glm::translate(glm::mat4(1.0f), _position));
+    draw(shader);
+}
+
 #endif /* SPRITE_H */
@@ -0,0 +1,203 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <unordered_map>
+#include "mesh.h"
+#include "image.h"
+#include "textureStreamer.h"
+#include "hash.h"
+#include "mappedFile.h"
+
+/*
+ * one gl texture per image file for the whole process, however many models use it
+ *
+ * textures are looked up by the hash of their resolved path first, then by the hash of
+ * the file's contents, so a copy of the same jpg under another name is still only uploaded
+ * once. handles are shared_ptrs, the texture is deleted when the last one drops and the
+ * cache only keeps weak references
+ *
+ * streamed textures go up smallest mips first through TextureStreamer, everything else
+ * whole
+ *
+ * find() is safe from any thread (decode jobs use it to skip textures that are already
+ * resident), acquire() uploads and so belongs on the gl thread
+ */
+
+struct TextureCacheStats {
+  uint   hits;
+  uint   misses;
+  uint   resident;
+  size_t residentBytes;
+};
+
+class TextureCache {
+  public:
+    TextureCache();
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    static TextureCache& shared();
+
+    // a texture already resident for the file, null if there isn't one
+    std::shared_ptr<Texture> find(const std::string& path);
+
+    // the cached texture for the file, decoding and uploading it on a miss. with `streamed`
+    // a big texture is handed to TextureStreamer, whoever draws with it then has to request() its detail
+    std::shared_ptr<Texture> acquire(const std::string& path, bool streamed = false);
+    // same, with pixels decoded ahead of time (image.data may be null if decoding was
+    // skipped because the texture was cached). the image is freed either way
+    std::shared_ptr<Texture> acquire(Image& image, bool streamed = false);
+
+    TextureCacheStats stats();
+    void report();
+
+  private:
+    std::mutex _mutex;
+
+    std::unordered_map<uint64_t, std::weak_ptr<Texture>> _byPath;
+    std::unordered_map<uint64_t, std::weak_ptr<Texture>> _byContent;
+
+    uint   _hits, _misses;
+    uint   _resident;
+    size_t _residentBytes;
+
+    std::shared_ptr<Texture> lookup(uint64_t pathKey, uint64_t contentHash);
+    std::shared_ptr<Texture> insert(uint64_t pathKey, Image& image, bool streamed);
+};
+
+static uint64_t texturePathKey(const std::string& path) {
+  std::string resolved = canonicalPath(path);
+  return hashBytes(resolved.data(), resolved.size());
+}
+
+TextureCache::TextureCache()
+  : _hits(0), _misses(0), _resident(0), _residentBytes(0) {
+}
+
+TextureCache& TextureCache::shared() {
+  static TextureCache cache;
+  return cache;
+}
+
+std::shared_ptr<Texture> TextureCache::find(const std::string& path) {
+  uint64_t key = texturePathKey(path);
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto found = _byPath.find(key);
+  return found == _byPath.end() ? nullptr : found->second.lock();
+}
+
+// hit by path, or by content under a new path which is then remembered too. caller holds the lock
+std::shared_ptr<Texture> TextureCache::lookup(uint64_t pathKey, uint64_t contentHash) {
+  auto found = _byPath.find(pathKey);
+  if (found != _byPath.end()) {
+    if (std::shared_ptr<Texture> texture = found->second.lock()) return texture;
+  }
+
+  if (contentHash == 0) return nullptr;
+  found = _byContent.find(contentHash);
+  if (found != _byContent.end()) {
+    if (std::shared_ptr<Texture> texture = found->second.lock()) {
+      _byPath[pathKey] = texture;
+      return texture;
+    }
+  }
+  return nullptr;
+}
+
+std::shared_ptr<Texture> TextureCache::acquire(const std::string& path, bool streamed) {
+  uint64_t key = texturePathKey(path);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (std::shared_ptr<Texture> texture = lookup(key, 0)) {
+      _hits++;
+      return texture;
+    }
+  }
+
+  Image image = loadImage(path);
+  return acquire(image, streamed);
+}
+
+std::shared_ptr<Texture> TextureCache::acquire(Image& image, bool streamed) {
+  uint64_t key = texturePathKey(image.path);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (std::shared_ptr<Texture> texture = lookup(key, image.contentHash)) {
+      _hits++;
+      freeImage(image);
+      return texture;
+    }
+  }
+
+  // decoding was skipped but the texture has gone since, do it now
+  if (!imageLoaded(image)) {
+    std::string path = image.path;
+    image = loadImage(path);
+  }
+
+  std::shared_ptr<Texture> texture = insert(key, image, streamed);
+  freeImage(image);
+  return texture;
+}
+
+std::shared_ptr<Texture> TextureCache::insert(uint64_t pathKey, Image& image, bool streamed) {
+  // the full mip chain is a third on top of the base level, cooked and cpu built ones know their size
+  size_t bytes = image.cooked ? image.cooked->dataSize()
+               : image.mips   ? image.mips->size()
+               : (size_t)image.width * image.height * image.channels * 4 / 3;
+  uint64_t contentHash = image.contentHash;
+
+  std::shared_ptr<Texture> texture(new Texture(), [this, bytes](Texture* texture) {
+    TextureStreamer::shared().remove(texture->id);
+    delete texture;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _resident--;
+    _residentBytes -= bytes;
+  });
+  texture->id   = streamed && TextureStreamer::streamable(image) ? TextureStreamer::shared().add(image) : uploadTexture(image);
+  texture->path = image.path;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _misses++;
+  _resident++;
+  _residentBytes += bytes;
+
+  // forget entries whose texture is gone before adding, so the tables stay the size of what's resident
+  for (auto it = _byPath.begin(); it != _byPath.end();) {
+    if (it->second.expired()) it = _byPath.erase(it);
+    else                      ++it;
+  }
+  for (auto it = _byContent.begin(); it != _byContent.end();) {
+    if (it->second.expired()) it = _byContent.erase(it);
+    else                      ++it;
+  }
+
+  _byPath[pathKey] = texture;
+  if (contentHash != 0) _byContent[contentHash] = texture;
+  return texture;
+}
+
+TextureCacheStats TextureCache::stats() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return { _hits, _misses, _resident, _residentBytes };
+}
+
+void TextureCache::report() {
+  TextureCacheStats s = stats();
+  std::cout << "INFO::TEXTURECACHE::" << s.resident << " textures, "
+            << s.residentBytes / (1024 * 1024) << " MiB resident, "
+            << s.hits << " hits, " << s.misses << " misses" << std::endl;
+
+  TextureStreamStats streams = TextureStreamer::shared().stats();
+  std::cout << "INFO::TEXTURESTREAMER::" << streams.streamed << " textures streaming, "
+            << streams.residentBytes / (1024 * 1024) << " MiB of their levels resident" << std::endl;
+}
+
+#endif /* TEXTURECACHE_H */
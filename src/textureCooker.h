@@ -0,0 +1,194 @@
+#ifndef TEXTURECOOKER_H
+#define TEXTURECOOKER_H
+
+#include <vector>
+#include <string>
+#include <future>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include "image.h"
+#include "ktx.h"
+#include "threadPool.h"
+#include "blockCompression.h"
+
+/*
+ * offline texture cooking: decode once, build the mip chain (imageProcessing.h, the same
+ * one loadImage builds for uncooked textures), block compress every level
+ * on the thread pool and write it all to a ktx next to the source (see `make cook`)
+ *
+ *   COOKED_FORMAT_BC    bc1 for opaque rgb, bc3 with alpha, bc5 for one or two channels
+ *   COOKED_FORMAT_ETC2  etc2 rgb for drivers without s3tc, opaque images only
+ *
+ * every block is decoded again right after it's encoded so the report can give the
+ * psnr against the source, for the top level and over the whole chain
+ */
+
+#define COOK_BLOCK_ROWS_PER_JOB 16
+
+enum CookedFormat {
+  COOKED_FORMAT_BC,
+  COOKED_FORMAT_ETC2
+};
+
+struct CookReport {
+  std::string source;
+  std::string output;
+  std::string format;
+  uint        width, height, levels;
+  size_t      uncompressedBytes;
+  size_t      cookedBytes;
+  // in dB, over the channels the format keeps
+  double      psnrTopLevel;
+  double      psnrAllLevels;
+  double      milliseconds;
+};
+
+std::string cookedTexturePath(const std::string& source, CookedFormat format) {
+  return source + (format == COOKED_FORMAT_BC ? COOKED_BC_EXTENSION : COOKED_ETC2_EXTENSION);
+}
+
+// what each block format keeps and how it's called
+struct BlockFormat {
+  const char* name;
+  uint32_t    internalFormat;
+  uint32_t    baseInternalFormat;
+  uint        blockBytes;
+  uint        channels;
+  void (*encode)(const ColorBlock&, uint8_t*);
+  void (*decode)(const uint8_t*, ColorBlock&);
+};
+
+static void decodeBc1Opaque(const uint8_t* in, ColorBlock& block) { decodeBc1(in, block); }
+
+static const BlockFormat BLOCK_FORMAT_BC1  = { "BC1",  GL_COMPRESSED_RGB_S3TC_DXT1_EXT,  GL_RGB,  BC1_BLOCK_BYTES,  3, encodeBc1,  decodeBc1Opaque };
+static const BlockFormat BLOCK_FORMAT_BC3  = { "BC3",  GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_RGBA, BC3_BLOCK_BYTES,  4, encodeBc3,  decodeBc3 };
+static const BlockFormat BLOCK_FORMAT_BC5  = { "BC5",  GL_COMPRESSED_RG_RGTC2,           GL_RG,   BC5_BLOCK_BYTES,  2, encodeBc5,  decodeBc5 };
+static const BlockFormat BLOCK_FORMAT_ETC2 = { "ETC2", GL_COMPRESSED_RGB8_ETC2,          GL_RGB,  ETC2_BLOCK_BYTES, 3, encodeEtc2, decodeEtc2 };
+
+// encodes block rows [firstRow, lastRow) of one level, returns the squared error of decoding them again
+static double encodeBlockRows(const BlockFormat& format, const std::vector<uint8_t>& rgba, uint width, uint height,
+                              uint firstRow, uint lastRow, uint8_t* out) {
+  uint blocksX = (width + 3) / 4;
+  double error = 0.0;
+
+  for (uint by = firstRow; by < lastRow; by++) {
+    for (uint bx = 0; bx < blocksX; bx++) {
+      // blocks hanging over the edge repeat the last pixel, the decoded overhang is never sampled
+      ColorBlock block;
+      for (uint i = 0; i < 16; i++) {
+        uint x = std::min(bx * 4 + i % 4, width - 1);
+        uint y = std::min(by * 4 + i / 4, height - 1);
+        std::memcpy(block.rgba[i], &rgba[((size_t)y * width + x) * 4], 4);
+      }
+
+      uint8_t* encoded = out + ((size_t)by * blocksX + bx) * format.blockBytes;
+      format.encode(block, encoded);
+
+      ColorBlock decoded;
+      format.decode(encoded, decoded);
+      for (uint i = 0; i < 16; i++) {
+        if (bx * 4 + i % 4 >= width || by * 4 + i / 4 >= height) continue;
+        for (uint c = 0; c < format.channels; c++) {
+          int d = (int)block.rgba[i][c] - decoded.rgba[i][c];
+          error += d * d;
+        }
+      }
+    }
+  }
+  return error;
+}
+
+static double psnr(double squaredError, double samples) {
+  if (squaredError == 0.0) return INFINITY;
+  return 10.0 * std::log10(255.0 * 255.0 * samples / squaredError);
+}
+
+bool cookTexture(const std::string& source, CookedFormat cookedFormat, CookReport& report, ThreadPool& pool = ThreadPool::shared()) {
+  auto start = std::chrono::steady_clock::now();
+
+  Image image = decodeImage(source);
+  if (!image.data) {
+    std::cout << "ERROR::COOK::DECODE_FAILED '" << source << "'" << std::endl;
+    return false;
+  }
+
+  MipChain mips = buildMipChain(image.data, image.width, image.height, image.channels, mipOptions(image));
+  bool opaque = true;
+  const std::vector<uint8_t>& top = mips.levels[0];
+  for (size_t i = 3; i < top.size() && image.channels == 4; i += 4) opaque = opaque && top[i] == 255;
+  uint channels = image.channels;
+  uint width = image.width, height = image.height;
+  freeImage(image);
+
+  const BlockFormat* format;
+  if (cookedFormat == COOKED_FORMAT_BC) {
+    format = channels <= 2 ? &BLOCK_FORMAT_BC5 : opaque ? &BLOCK_FORMAT_BC1 : &BLOCK_FORMAT_BC3;
+  } else {
+    if (channels <= 2 || !opaque) {
+      std::cout << "WARNING::COOK::NO_ETC2_ENCODER '" << source << "' needs alpha or two channels, left uncooked" << std::endl;
+      return false;
+    }
+    format = &BLOCK_FORMAT_ETC2;
+  }
+
+  std::vector<std::vector<uint8_t>> levels;
+  double totalError = 0.0, totalSamples = 0.0, topError = 0.0, topSamples = 0.0;
+  size_t uncompressedBytes = 0;
+
+  for (uint level = 0; level < mips.levels.size(); level++) {
+    const std::vector<uint8_t>& rgba = mips.levels[level];
+    uint w = mips.levelWidth(level), h = mips.levelHeight(level);
+    uint blocksX = (w + 3) / 4, blocksY = (h + 3) / 4;
+    levels.emplace_back((size_t)blocksX * blocksY * format->blockBytes);
+    uint8_t* out = levels.back().data();
+
+    std::vector<std::future<double>> jobs;
+    for (uint row = 0; row < blocksY; row += COOK_BLOCK_ROWS_PER_JOB) {
+      uint last = std::min(row + COOK_BLOCK_ROWS_PER_JOB, blocksY);
+      jobs.push_back(pool.submit([format, &rgba, w, h, row, last, out]() {
+        return encodeBlockRows(*format, rgba, w, h, row, last, out);
+      }));
+    }
+
+    double error = 0.0;
+    for (std::future<double>& job : jobs) error += job.get();
+    double samples = (double)w * h * format->channels;
+    if (levels.size() == 1) {
+      topError = error;
+      topSamples = samples;
+    }
+    totalError += error;
+    totalSamples += samples;
+    uncompressedBytes += (size_t)w * h * channels;
+  }
+
+  report.source = source;
+  report.output = cookedTexturePath(source, cookedFormat);
+  report.format = format->name;
+  report.width  = width;
+  report.height = height;
+  report.levels = levels.size();
+  report.uncompressedBytes = uncompressedBytes;
+  report.cookedBytes = 0;
+  for (const std::vector<uint8_t>& level : levels) report.cookedBytes += level.size();
+  report.psnrTopLevel  = psnr(topError, topSamples);
+  report.psnrAllLevels = psnr(totalError, totalSamples);
+
+  if (!writeKtx(report.output, format->internalFormat, format->baseInternalFormat, width, height, levels)) {
+    std::cout << "ERROR::COOK::WRITE_FAILED '" << report.output << "'" << std::endl;
+    return false;
+  }
+
+  report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return true;
+}
+
+void printCookReport(const CookReport& report) {
+  std::printf("%-28s %-5s %5ux%-5u %2u levels  %7.2f -> %6.2f MiB  PSNR %5.2f dB (all levels %5.2f)  %6.0f ms\n",
+              report.source.c_str(), report.format.c_str(), report.width, report.height, report.levels,
+              report.uncompressedBytes / 1048576.0, report.cookedBytes / 1048576.0,
+              report.psnrTopLevel, report.psnrAllLevels, report.milliseconds);
+}
+
+#endif /* TEXTURECOOKER_H */
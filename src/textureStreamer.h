@@ -0,0 +1,279 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include "glad/glad.h"
+#include "image.h"
+#include "ktx.h"
+#include "glState.h"
+#include "imageProcessing.h"
+#include "loadProfiler.h"
+
+/*
+ * progressive mip streaming for big textures
+ *
+ * add() uploads only the small end of the chain (levels no bigger than
+ * TEXTURE_STREAM_INITIAL_SIZE) so the texture can be drawn with straight away. every frame
+ * whatever draws with it says how big it is on screen through request(), and update()
+ * uploads the next finer level of the textures that are short of detail, a strip of rows
+ * at a time within TEXTURE_STREAM_BUDGET bytes a frame. a level is only sampled once it's
+ * all there: GL_TEXTURE_BASE_LEVEL is the finest complete level, MAX_LEVEL the 1x1 one
+ *
+ * a level nobody has needed for TEXTURE_STREAM_EVICT_FRAMES frames is dropped again, so
+ * far away or off screen props don't keep mip 0 around. the textures are mutable, one
+ * glTexImage2D per level rather than glTexStorage2D, so a level that isn't loaded costs
+ * no video memory
+ *
+ * the source levels stay on the cpu as long as the texture lives: just a mapping for
+ * cooked ktx files, the rgba chain otherwise
+ *
+ * gl thread only
+ */
+
+// anything smaller goes up whole
+#define TEXTURE_STREAM_MIN_SIZE     512
+#define TEXTURE_STREAM_INITIAL_SIZE 64
+#define TEXTURE_STREAM_BUDGET       (4 << 20)
+#define TEXTURE_STREAM_EVICT_FRAMES 120
+
+struct TextureStreamStats {
+  uint   streamed;
+  size_t residentBytes;
+  // by the last update
+  size_t uploadedBytes;
+};
+
+class TextureStreamer {
+  public:
+    TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    static TextureStreamer& shared();
+
+    // whether add() takes the image, it has to have its whole chain and be big enough to bother
+    static bool streamable(const Image& image);
+    // creates the texture with only its smallest levels, returns its gl name
+    uint add(const Image& image);
+    // before the texture is deleted
+    void remove(uint texture);
+
+    // something `pixels` across on screen is drawn with the texture this frame,
+    // ignored for textures that aren't streamed
+    void request(uint texture, float pixels);
+    // once a frame, uploads toward what was requested and evicts what wasn't
+    void update();
+
+    TextureStreamStats stats();
+
+  private:
+    struct Stream {
+      std::shared_ptr<MipChain>   mips;
+      std::shared_ptr<KtxTexture> cooked;
+      uint width, height, levelCount;
+      // what add() uploaded, never evicted
+      uint initialLevel;
+      // finest complete level, the one sampled
+      uint baseLevel;
+      // finest level asked for since the last update, levelCount if none was
+      uint wantedLevel;
+      // rows of baseLevel - 1 uploaded so far
+      uint pendingRows;
+      uint idleFrames;
+    };
+
+    std::unordered_map<uint, Stream> _streams;
+    size_t _residentBytes, _uploadedBytes;
+
+    static uint levelWidth(const Stream& stream, uint level)  { return std::max(stream.width >> level, 1u); }
+    static uint levelHeight(const Stream& stream, uint level) { return std::max(stream.height >> level, 1u); }
+    static size_t levelBytes(const Stream& stream, uint level);
+
+    static void uploadLevel(const Stream& stream, uint level);
+    static void uploadRows(const Stream& stream, uint level, uint firstRow, uint rows);
+    static void dropLevel(uint level);
+    static void clamp(const Stream& stream);
+};
+
+TextureStreamer::TextureStreamer()
+  : _residentBytes(0), _uploadedBytes(0) {
+}
+
+TextureStreamer& TextureStreamer::shared() {
+  static TextureStreamer streamer;
+  return streamer;
+}
+
+bool TextureStreamer::streamable(const Image& image) {
+  if (!image.mips && !image.cooked) return false;
+  return (uint)std::max(image.width, image.height) >= TEXTURE_STREAM_MIN_SIZE;
+}
+
+size_t TextureStreamer::levelBytes(const Stream& stream, uint level) {
+  return stream.cooked ? stream.cooked->levels[level].size : stream.mips->levels[level].size();
+}
+
+// defines the level with all its pixels, the texture is bound
+void TextureStreamer::uploadLevel(const Stream& stream, uint level) {
+  uint w = levelWidth(stream, level), h = levelHeight(stream, level);
+  if (stream.cooked) {
+    const KtxLevel& image = stream.cooked->levels[level];
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, stream.cooked->internalFormat, w, h, 0, image.size, image.data);
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, stream.mips->levels[level].data());
+  }
+}
+
+// rgba levels only, the level has already been defined
+void TextureStreamer::uploadRows(const Stream& stream, uint level, uint firstRow, uint rows) {
+  uint w = levelWidth(stream, level);
+  const uint8_t* pixels = stream.mips->levels[level].data() + (size_t)firstRow * w * 4;
+  glTexSubImage2D(GL_TEXTURE_2D, level, 0, firstRow, w, rows, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+// an empty image gives the level's memory back, outside BASE_LEVEL..MAX_LEVEL it doesn't
+// matter to completeness that it no longer matches the others
+void TextureStreamer::dropLevel(uint level) {
+  glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+}
+
+void TextureStreamer::clamp(const Stream& stream) {
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, stream.baseLevel);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, stream.levelCount - 1);
+}
+
+uint TextureStreamer::add(const Image& image) {
+  Stream stream;
+  stream.mips   = image.mips;
+  stream.cooked = image.cooked;
+  stream.width  = image.cooked ? image.cooked->width : image.mips->width;
+  stream.height = image.cooked ? image.cooked->height : image.mips->height;
+  stream.levelCount = image.cooked ? image.cooked->levels.size() : image.mips->levels.size();
+
+  stream.initialLevel = 0;
+  while (stream.initialLevel + 1 < stream.levelCount &&
+         std::max(levelWidth(stream, stream.initialLevel), levelHeight(stream, stream.initialLevel)) > TEXTURE_STREAM_INITIAL_SIZE)
+    stream.initialLevel++;
+  stream.baseLevel   = stream.initialLevel;
+  stream.wantedLevel = stream.levelCount;
+  stream.pendingRows = 0;
+  stream.idleFrames  = 0;
+
+  LoadTimer timer(LOAD_STAGE_TEXTURE_UPLOAD, image.path);
+  uint texture;
+  glGenTextures(1, &texture);
+  GLState::shared().bindTexture(texture);
+
+  // rgba rows are 4 byte aligned, cooked levels are whole blocks
+  for (uint level = stream.baseLevel; level < stream.levelCount; level++) {
+    uploadLevel(stream, level);
+    _residentBytes += levelBytes(stream, level);
+    LoadProfiler::shared().addUpload(image.path, levelBytes(stream, level));
+  }
+  clamp(stream);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  _streams[texture] = stream;
+  return texture;
+}
+
+void TextureStreamer::remove(uint texture) {
+  auto found = _streams.find(texture);
+  if (found == _streams.end()) return;
+
+  const Stream& stream = found->second;
+  for (uint level = stream.baseLevel; level < stream.levelCount; level++)
+    _residentBytes -= levelBytes(stream, level);
+  _streams.erase(found);
+}
+
+void TextureStreamer::request(uint texture, float pixels) {
+  auto found = _streams.find(texture);
+  if (found == _streams.end()) return;
+
+  // one texel per pixel across the prop: each level down halves the texels
+  Stream& stream = found->second;
+  float texels = std::max(stream.width, stream.height);
+  uint level = 0;
+  if (pixels < texels) level = std::min((uint)std::floor(std::log2(texels / std::max(pixels, 1.0f))), stream.levelCount - 1);
+  stream.wantedLevel = std::min(stream.wantedLevel, level);
+}
+
+void TextureStreamer::update() {
+  _uploadedBytes = 0;
+
+  // furthest behind what they were asked for first
+  std::vector<std::pair<uint, Stream*>> behind;
+  for (auto& entry : _streams)
+    if (entry.second.wantedLevel < entry.second.baseLevel) behind.push_back({ entry.first, &entry.second });
+  std::sort(behind.begin(), behind.end(), [](const std::pair<uint, Stream*>& a, const std::pair<uint, Stream*>& b) {
+    return a.second->baseLevel - a.second->wantedLevel > b.second->baseLevel - b.second->wantedLevel;
+  });
+
+  for (auto& entry : behind) {
+    if (_uploadedBytes >= TEXTURE_STREAM_BUDGET) break;
+    Stream& stream = *entry.second;
+    uint level = stream.baseLevel - 1;
+    uint h = levelHeight(stream, level);
+    GLState::shared().bindTexture(entry.first);
+
+    if (stream.cooked) {
+      // compressed levels are small enough to go up whole
+      uploadLevel(stream, level);
+      stream.pendingRows = h;
+      _uploadedBytes += levelBytes(stream, level);
+    } else {
+      if (stream.pendingRows == 0)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, levelWidth(stream, level), h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+      // at least one row, so a level wider than the budget still gets there
+      size_t rowBytes = (size_t)levelWidth(stream, level) * 4;
+      uint rows = std::max((TEXTURE_STREAM_BUDGET - _uploadedBytes) / rowBytes, (size_t)1);
+      rows = std::min(rows, h - stream.pendingRows);
+      uploadRows(stream, level, stream.pendingRows, rows);
+      stream.pendingRows += rows;
+      _uploadedBytes += rows * rowBytes;
+    }
+
+    if (stream.pendingRows == h) {
+      stream.baseLevel = level;
+      stream.pendingRows = 0;
+      _residentBytes += levelBytes(stream, level);
+      clamp(stream);
+    }
+  }
+
+  for (auto& entry : _streams) {
+    Stream& stream = entry.second;
+    bool surplus = stream.wantedLevel > stream.baseLevel && stream.baseLevel < stream.initialLevel;
+    stream.idleFrames = surplus ? stream.idleFrames + 1 : 0;
+
+    // one level per TEXTURE_STREAM_EVICT_FRAMES, a prop flying away sheds detail gradually
+    if (stream.idleFrames >= TEXTURE_STREAM_EVICT_FRAMES) {
+      GLState::shared().bindTexture(entry.first);
+      if (stream.pendingRows) dropLevel(stream.baseLevel - 1);
+      _residentBytes -= levelBytes(stream, stream.baseLevel);
+      stream.baseLevel++;
+      stream.pendingRows = 0;
+      stream.idleFrames = 0;
+      clamp(stream);
+      dropLevel(stream.baseLevel - 1);
+    }
+    stream.wantedLevel = stream.levelCount;
+  }
+}
+
+TextureStreamStats TextureStreamer::stats() {
+  return { (uint)_streams.size(), _residentBytes, _uploadedBytes };
+}
+
+#endif /* TEXTURESTREAMER_H */
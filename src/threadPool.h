@@ -0,0 +1,125 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+// what a job returns. result_of is deprecated in 17 and gone in 20, invoke_result replaces it
+#if __cplusplus >= 201703L
+template <typename F>
+using JobResult = std::invoke_result_t<F>;
+#else
+template <typename F>
+using JobResult = typename std::result_of<F()>::type;
+#endif
+
+// fixed set of worker threads pulling jobs off a shared queue
+class ThreadPool {
+  public:
+    ThreadPool(uint threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename F>
+    std::future<JobResult<F>> submit(F job);
+
+    uint size() const;
+    // time the workers have spent running jobs, summed over all of them
+    double busyMilliseconds() const;
+
+    // pool shared by the loaders, created on first use
+    static ThreadPool& shared();
+    // true on any pool's worker threads. a job that waits on jobs it submits can take every
+    // worker and wait forever, so jobs do their work themselves instead
+    static bool onWorker();
+
+  private:
+    std::vector<std::thread>          _workers;
+    std::queue<std::function<void()>> _jobs;
+    std::mutex                        _mutex;
+    std::condition_variable           _wake;
+    bool                              _stopping;
+    std::atomic<uint64_t>             _busyNanoseconds;
+
+    void work();
+};
+
+ThreadPool::ThreadPool(uint threadCount)
+  : _stopping(false), _busyNanoseconds(0) {
+  if (threadCount == 0) threadCount = 1;
+  for (uint i = 0; i < threadCount; i++)
+    _workers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+  for (std::thread& worker : _workers) worker.join();
+}
+
+template <typename F>
+std::future<JobResult<F>> ThreadPool::submit(F job) {
+  typedef JobResult<F> Result;
+
+  // std::function needs something copyable, so the task lives behind a shared_ptr
+  std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(job);
+  std::future<Result> result = task->get_future();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _jobs.push([task]() { (*task)(); });
+  }
+  _wake.notify_one();
+  return result;
+}
+
+uint ThreadPool::size() const {
+  return _workers.size();
+}
+
+double ThreadPool::busyMilliseconds() const {
+  return _busyNanoseconds / 1e6;
+}
+
+ThreadPool& ThreadPool::shared() {
+  static ThreadPool pool;
+  return pool;
+}
+
+static thread_local bool threadPoolWorker = false;
+
+bool ThreadPool::onWorker() {
+  return threadPoolWorker;
+}
+
+void ThreadPool::work() {
+  threadPoolWorker = true;
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+      if (_stopping && _jobs.empty()) return;
+      job = std::move(_jobs.front());
+      _jobs.pop();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    job();
+    _busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+#endif /* THREADPOOL_H */
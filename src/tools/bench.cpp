@@ -0,0 +1,255 @@
+// load-path benchmarks, run with `make bench` from the repo root
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include "objLoader.h"
+#include "image.h"
+#include "imageProcessing.h"
+#include "vertexConversion.h"
+
+#define BENCH_RUNS 5
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the cpu half of Model::processNode/processMesh, without the gl upload
+size_t assimpLoad(const std::string& path) {
+  Assimp::Importer importer;
+  const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+  if (!scene || !scene->mRootNode) return 0;
+
+  size_t vertexCount = 0;
+  for (uint m = 0; m < scene->mNumMeshes; m++) {
+    aiMesh* mesh = scene->mMeshes[m];
+    std::vector<Vertex> vertices(mesh->mNumVertices);
+    convertVertices((const float*)mesh->mVertices, (const float*)mesh->mNormals,
+        (const float*)mesh->mTextureCoords[0], mesh->mNumVertices, vertices.data());
+
+    size_t indexCount = 0;
+    for (uint i = 0; i < mesh->mNumFaces; i++) indexCount += mesh->mFaces[i].mNumIndices;
+    std::vector<uint> indices(indexCount);
+    uint* index = indices.data();
+    for (uint i = 0; i < mesh->mNumFaces; i++) {
+      std::memcpy(index, mesh->mFaces[i].mIndices, mesh->mFaces[i].mNumIndices * sizeof(uint));
+      index += mesh->mFaces[i].mNumIndices;
+    }
+
+    vertexCount += vertices.size();
+  }
+  return vertexCount;
+}
+
+size_t objLoad(const std::string& path) {
+  ObjLoader loader(path);
+  if (!loader.load()) return 0;
+
+  size_t vertexCount = 0;
+  for (const MeshData& mesh : loader.meshes) vertexCount += mesh.vertices.size();
+  return vertexCount;
+}
+
+void benchObj(const std::string& path) {
+  if (fileSize(path) < 0) {
+    printf("%-24s missing, skipped\n", path.c_str());
+    return;
+  }
+
+  double assimpBest = 1e30, objBest = 1e30;
+  size_t assimpVertices = 0, objVertices = 0;
+
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    auto start = std::chrono::steady_clock::now();
+    assimpVertices = assimpLoad(path);
+    assimpBest = std::min(assimpBest, millisecondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    objVertices = objLoad(path);
+    objBest = std::min(objBest, millisecondsSince(start));
+  }
+
+  printf("%-24s assimp %9.2f ms (%zu verts)   objloader %9.2f ms (%zu verts)   %5.1fx\n",
+      path.c_str(), assimpBest, assimpVertices, objBest, objVertices, assimpBest / objBest);
+}
+
+// a usemtl that ends the first of two chunks has to hold for the faces in the second
+bool checkObjChunkBoundary() {
+  std::string before = "v 0 0 0\nv 1 0 0\nv 0 1 0\nusemtl a\nf 1 2 3\n";
+  std::string material = "usemtl b\n";
+  std::string after = "f 1 2 3\nf 1 2 3\n";
+
+  // the first chunk ends with the line holding the middle byte, so padded until that's the
+  // usemtl line's first byte
+  while (before.size() < material.size() + after.size()) before.insert(0, "#\n");
+  after.append(before.size() - material.size() - after.size(), '#');
+
+  const char* path = "/tmp/learnopengl-bench-boundary.obj";
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+  std::string contents = before + material + after;
+  fwrite(contents.data(), 1, contents.size(), file);
+  fclose(file);
+
+  ObjLoader loader(path);
+  bool loaded = loader.load(2);
+  std::remove(path);
+  return loaded && loader.meshes.size() == 2 && loader.meshes[0].indices.size() == 3 && loader.meshes[1].indices.size() == 6;
+}
+
+// a face in the second chunk whose relative v/vt/vn indices all point back into the first
+bool checkObjRelativeAcrossChunks() {
+  std::string before = "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvt 1 0\nvt 0 1\nvn 0 0 1\n";
+  std::string after = "f -3/-3/-1 -2/-2/-1 -1/-1/-1\n";
+
+  // the first chunk ends with the line holding the middle byte, `after` being the shorter
+  // puts that in `before` and the face at the start of the second chunk
+
+  const char* path = "/tmp/learnopengl-bench-relative.obj";
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+  std::string contents = before + after;
+  fwrite(contents.data(), 1, contents.size(), file);
+  fclose(file);
+
+  ObjLoader loader(path);
+  bool loaded = loader.load(2);
+  std::remove(path);
+  if (!loaded || loader.meshes.size() != 1 || loader.meshes[0].vertices.size() != 3) return false;
+
+  const std::vector<Vertex>& vertices = loader.meshes[0].vertices;
+  return vertices[1].position == glm::vec3(1, 0, 0) && vertices[2].texCoords == glm::vec2(0, 1) &&
+      vertices[0].normal == glm::vec3(0, 0, 1);
+}
+
+// best of BENCH_RUNS for both versions of a kernel, and whether they agree
+template <typename Scalar, typename Simd>
+void benchKernel(const char* name, size_t bytes, Scalar scalar, Simd simd, std::function<bool()> same) {
+  double scalarBest = 1e30, simdBest = 1e30;
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    auto start = std::chrono::steady_clock::now();
+    scalar();
+    scalarBest = std::min(scalarBest, millisecondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    simd();
+    simdBest = std::min(simdBest, millisecondsSince(start));
+  }
+
+  printf("%-24s scalar %9.2f ms   simd %9.2f ms   %5.1fx   %7.0f MiB/s   %s\n", name, scalarBest, simdBest,
+      scalarBest / simdBest, bytes / 1048576.0 / (simdBest / 1000.0), same() ? "match" : "MISMATCH");
+}
+
+// vertexConversion.h against its scalar references, on a mesh's attributes laid out the
+// way assimp hands them over
+void benchVertices(const std::string& path) {
+  ObjLoader loader(path);
+  if (!loader.load() || loader.meshes.empty()) {
+    printf("%-24s missing, skipped\n", path.c_str());
+    return;
+  }
+
+  const std::vector<Vertex>& source = loader.meshes[0].vertices;
+  size_t count = source.size();
+  std::vector<float> positions(count * 3), normals(count * 3), texCoords(count * 3);
+  for (size_t i = 0; i < count; i++) {
+    std::memcpy(&positions[i * 3], &source[i].position, sizeof(glm::vec3));
+    std::memcpy(&normals[i * 3],   &source[i].normal,   sizeof(glm::vec3));
+    std::memcpy(&texCoords[i * 3], &source[i].texCoords, sizeof(glm::vec2));
+  }
+
+  std::vector<Vertex> vertices(count), reference(count);
+  printf("%s, %zu vertices\n", path.c_str(), count);
+  benchKernel("  to interleaved", count * 36,
+      [&]() { convertVerticesScalar(positions.data(), normals.data(), texCoords.data(), count, reference.data()); },
+      [&]() { convertVertices(positions.data(), normals.data(), texCoords.data(), count, vertices.data()); },
+      [&]() { return std::memcmp(vertices.data(), reference.data(), count * sizeof(Vertex)) == 0; });
+
+  std::vector<float> x(count), y(count), z(count), xReference(count), yReference(count), zReference(count);
+  benchKernel("  to streams", count * 12,
+      [&]() { deinterleave3Scalar(positions.data(), count, xReference.data(), yReference.data(), zReference.data()); },
+      [&]() { deinterleave3(positions.data(), count, x.data(), y.data(), z.data()); },
+      [&]() { return x == xReference && y == yReference && z == zReference; });
+}
+
+// rgba and mip kernels from imageProcessing.h against their scalar references
+void benchImage(const std::string& path) {
+  Image image = decodeImage(path);
+  if (!image.data) {
+    printf("%-24s missing, skipped\n", path.c_str());
+    return;
+  }
+
+  uint width = image.width, height = image.height, channels = image.channels;
+  size_t pixels = (size_t)width * height;
+  uint halfWidth = std::max(width / 2, 1u), halfHeight = std::max(height / 2, 1u);
+  std::vector<uint8_t> rgba(pixels * 4), reference(pixels * 4);
+  std::vector<uint8_t> half((size_t)halfWidth * halfHeight * 4), halfReference(half.size());
+  auto sameHalf = [&]() { return half == halfReference; };
+
+  printf("%s, %ux%u, %u channels\n", path.c_str(), width, height, channels);
+  benchKernel("  expand to rgba", pixels * channels,
+      [&]() { expandToRgbaScalar(image.data, channels, reference.data(), pixels); },
+      [&]() { expandToRgba(image.data, channels, rgba.data(), pixels); },
+      [&]() { return rgba == reference; });
+
+  benchKernel("  premultiply", pixels * 4,
+      [&]() { premultiplyAlphaScalar(reference.data(), pixels, false); },
+      [&]() { premultiplyAlpha(rgba.data(), pixels, false); },
+      [&]() { return rgba == reference; });
+
+  expandToRgba(image.data, channels, rgba.data(), pixels);
+  benchKernel("  box", pixels * 4,
+      [&]() { downsampleBoxScalar(rgba.data(), width, height, halfReference.data(), false); },
+      [&]() { downsampleBox(rgba.data(), width, height, half.data(), false); }, sameHalf);
+
+  benchKernel("  box srgb", pixels * 4,
+      [&]() { downsampleBoxScalar(rgba.data(), width, height, halfReference.data(), true); },
+      [&]() { downsampleBox(rgba.data(), width, height, half.data(), true); }, sameHalf);
+
+  // float sums in a different order, so within one step rather than identical
+  auto closeHalf = [&]() {
+    for (size_t i = 0; i < half.size(); i++)
+      if (std::abs(half[i] - halfReference[i]) > 1) return false;
+    return true;
+  };
+  benchKernel("  kaiser srgb", pixels * 4,
+      [&]() { downsampleKaiserScalar(rgba.data(), width, height, halfReference.data(), true); },
+      [&]() { downsampleKaiser(rgba.data(), width, height, half.data(), true); }, closeHalf);
+
+  double chainBest = 1e30;
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    auto start = std::chrono::steady_clock::now();
+    MipChain chain = buildMipChain(image.data, width, height, channels, mipOptions(image));
+    chainBest = std::min(chainBest, millisecondsSince(start));
+  }
+  printf("  %-22s %9.2f ms for the whole chain\n", "mip chain (box, srgb)", chainBest);
+
+  freeImage(image);
+}
+
+int main() {
+  printf("obj import, best of %d\n", BENCH_RUNS);
+  benchObj("assets/asteroid1.obj");
+  benchObj("assets/asteroid2.obj");
+  benchObj("assets/asteroid3.obj");
+  printf("%-24s %s\n", "usemtl on a chunk edge", checkObjChunkBoundary() ? "match" : "MISMATCH");
+  printf("%-24s %s\n", "relative across chunks", checkObjRelativeAcrossChunks() ? "match" : "MISMATCH");
+
+  printf("\nvertex conversion, best of %d\n", BENCH_RUNS);
+  benchVertices("assets/asteroid1.obj");
+
+  printf("\ntexture processing, best of %d\n", BENCH_RUNS);
+  benchImage("assets/asteroid1.jpg");
+  return 0;
+}
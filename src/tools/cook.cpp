@@ -0,0 +1,50 @@
+// texture cooker, run with `make cook` from the repo root
+//
+//   bin/cook                      cooks every jpg and png in assets/ to bc and etc2
+//   bin/cook [--bc|--etc2] files  cooks just those, to both formats unless one is given
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "textureCooker.h"
+
+#define COOK_ASSET_DIRECTORY "assets"
+
+std::vector<std::string> assetTextures() {
+  std::vector<std::string> files;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(COOK_ASSET_DIRECTORY, error)) {
+    std::string extension = entry.path().extension().string();
+    if (extension == ".jpg" || extension == ".jpeg" || extension == ".png") files.push_back(entry.path().string());
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+int main(int argc, char** argv) {
+  std::vector<CookedFormat> formats = { COOKED_FORMAT_BC, COOKED_FORMAT_ETC2 };
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; i++) {
+    if      (std::strcmp(argv[i], "--bc") == 0)   formats = { COOKED_FORMAT_BC };
+    else if (std::strcmp(argv[i], "--etc2") == 0) formats = { COOKED_FORMAT_ETC2 };
+    else    files.push_back(argv[i]);
+  }
+  if (files.empty()) files = assetTextures();
+
+  int failed = 0;
+  for (const std::string& file : files) {
+    for (CookedFormat format : formats) {
+      CookReport report;
+      if (cookTexture(file, format, report)) printCookReport(report);
+      else                                   failed++;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+// asset packer, run with `make pack` from the repo root
+//
+//   bin/pack [--compress] [output]   packs assets/ and src/shaders/ into output (assets.pack)
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+
+#include "assetPack.h"
+
+static const char* PACK_DIRECTORIES[] = { "assets", "src/shaders" };
+
+// build leftovers that aren't assets
+bool packable(const std::filesystem::path& path) {
+  std::string extension = path.extension().string();
+  return extension != ".tmp" && extension != ".pack";
+}
+
+int main(int argc, char** argv) {
+  bool compress = false;
+  std::string output = ASSET_PACK_PATH;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--compress") == 0) compress = true;
+    else                                         output = argv[i];
+  }
+
+  std::vector<std::string> files;
+  for (const char* directory : PACK_DIRECTORIES) {
+    std::error_code error;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+      if (entry.is_regular_file() && packable(entry.path())) files.push_back(entry.path().generic_string());
+  }
+  std::sort(files.begin(), files.end());
+
+  if (!writeAssetPack(output, files, compress)) {
+    printf("failed to write %s\n", output.c_str());
+    return 1;
+  }
+
+  AssetPack pack;
+  if (!pack.open(output)) return 1;
+
+  size_t sourceBytes = 0;
+  for (const std::string& file : files) sourceBytes += std::max<int64_t>(std::filesystem::file_size(file), 0);
+  printf("%zu files, %.2f MiB -> %.2f MiB\n", files.size(), sourceBytes / 1048576.0, std::filesystem::file_size(output) / 1048576.0);
+  return 0;
+}
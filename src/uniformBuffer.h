@@ -0,0 +1,124 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+#include <glm/glm.hpp>
+#include "glad/glad.h"
+#include "glState.h"
+
+/*
+ * std140 uniform blocks shared by every shader, filled once a frame
+ *
+ *   FrameData  view, projection and camera position
+ *   LightData  the directional light, the flashlight and the spot and point light arrays
+ *
+ * each block has a fixed binding point. Shader hooks up any of these blocks a program
+ * declares when it's linked, so switching shaders never means sending the camera again.
+ * the structs here mirror the glsl declarations byte for byte: std140 pads a vec3 to 16
+ * bytes, so every vec3 is followed by the float that fills it out
+ */
+
+#define FRAME_DATA_BINDING 0
+#define LIGHT_DATA_BINDING 1
+
+// the arrays in litobject.frag have to be declared with the same sizes.
+// 64 of each keeps LightData under the 16KB every implementation allows a block
+#define MAX_SPOT_LIGHTS  64
+#define MAX_POINT_LIGHTS 64
+
+struct UniformBlockBinding {
+  const char* name;
+  uint        binding;
+};
+
+static const UniformBlockBinding UNIFORM_BLOCK_BINDINGS[] = {
+  { "FrameData", FRAME_DATA_BINDING },
+  { "LightData", LIGHT_DATA_BINDING },
+};
+
+struct FrameData {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 viewPos;   float _padding;
+};
+
+struct DirectionalLightData {
+  glm::vec3 direction; float _padding0;
+  glm::vec3 ambient;   float _padding1;
+  glm::vec3 diffuse;   float _padding2;
+  glm::vec3 specular;  float _padding3;
+};
+
+struct PointLightData {
+  glm::vec3 position;  float constant;
+  glm::vec3 ambient;   float linear;
+  glm::vec3 diffuse;   float quadratic;
+  glm::vec3 specular;  float _padding;
+};
+
+struct SpotLightData {
+  glm::vec3 position;  float innerCone;
+  glm::vec3 direction; float outerCone;
+  glm::vec3 ambient;   float constant;
+  glm::vec3 diffuse;   float linear;
+  glm::vec3 specular;  float quadratic;
+};
+
+struct LightData {
+  DirectionalLightData dirLight;
+  SpotLightData        flashlight;
+  int32_t              usingFlashlight;
+  int32_t              spotLightAmount;
+  int32_t              pointLightAmount;
+  int32_t              _padding;
+  SpotLightData        spotLights[MAX_SPOT_LIGHTS];
+  PointLightData       pointLights[MAX_POINT_LIGHTS];
+};
+
+static_assert(sizeof(FrameData) == 144, "FrameData has to match its std140 layout");
+static_assert(sizeof(DirectionalLightData) == 64 && sizeof(PointLightData) == 64 && sizeof(SpotLightData) == 80,
+    "light structs have to match their std140 layout");
+static_assert(offsetof(LightData, usingFlashlight) == 144 && offsetof(LightData, spotLights) == 160,
+    "LightData has to match its std140 layout");
+static_assert(sizeof(LightData) <= 16384, "LightData is past the smallest GL_MAX_UNIFORM_BLOCK_SIZE");
+
+// a block's buffer and the cpu copy it's filled from. write into data, then upload()
+// sends the whole thing with a single glBufferSubData
+template <typename T>
+class UniformBuffer {
+  public:
+    T data = {};
+
+    UniformBuffer(uint binding);
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void upload();
+
+  private:
+    uint _buffer = 0;
+};
+
+template <typename T>
+UniformBuffer<T>::UniformBuffer(uint binding) {
+  glGenBuffers(1, &_buffer);
+  GLState::shared().bindBuffer(GL_UNIFORM_BUFFER, _buffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+  GLState::shared().bindBufferBase(GL_UNIFORM_BUFFER, binding, _buffer);
+}
+
+template <typename T>
+UniformBuffer<T>::~UniformBuffer() {
+  if (_buffer) GLState::shared().deleteBuffer(_buffer);
+}
+
+template <typename T>
+void UniformBuffer<T>::upload() {
+  GLState::shared().bufferSubData(GL_UNIFORM_BUFFER, _buffer, 0, sizeof(T), &data);
+}
+
+#endif /* UNIFORMBUFFER_H */
@@ -0,0 +1,39 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// the vertex formats meshes are uploaded in, see Mesh and GeometryArena
+
+struct Vertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 texCoords;
+};
+
+// opt-in 16 byte layout: positions as snorm16 inside the mesh bounds, octahedral snorm16
+// normals and unorm16 texture coordinates inside the uv bounds, see VertexQuantization
+struct PackedVertex {
+  int16_t  position[4];
+  int16_t  normal[2];
+  uint16_t texCoords[2];
+};
+
+enum VertexLayout {
+  VERTEX_LAYOUT_FLOAT,
+  VERTEX_LAYOUT_PACKED
+};
+
+#define VERTEX_LAYOUT_COUNT 2
+
+// per instance of an instanced draw, read by instanced.vert from INSTANCE_ATTRIBUTE_FIRST
+// on: the model matrix as four vec4 columns, then the tint
+struct InstanceData {
+  glm::mat4 transform;
+  glm::vec4 tint;
+};
+
+#define INSTANCE_ATTRIBUTE_FIRST 3
+
+#endif /* VERTEX_H */
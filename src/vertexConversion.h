@@ -0,0 +1,177 @@
+#ifndef VERTEXCONVERSION_H
+#define VERTEXCONVERSION_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <initializer_list>
+#include <sys/types.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * bulk conversion from importer arrays (assimp's aiVector3D, three floats a vertex, one
+ * array per attribute) into what the renderer and the cpu passes want
+ *
+ *   convertVertices       to the interleaved Vertex layout the mesh is uploaded from
+ *   convertVertexStreams  to VertexStreams, one array per component. only a kernel so
+ *                         far, the cpu passes (bounds, simplification) still walk
+ *                         Vertex and nothing in the loader calls it, see tools/bench.cpp
+ *
+ * the caller sizes the output once, there's no push_back per vertex. the *Scalar versions
+ * are the reference and take the tails, sse2 or neon do the bulk. normals and texCoords
+ * can be null, they come out as zero
+ *
+ * no gl here, this runs on the loading threads
+ */
+
+// from mesh.h, written here as 8 floats: position, normal, texCoords
+struct Vertex;
+
+// structure of arrays, all the same length
+struct VertexStreams {
+  std::vector<float> positionX, positionY, positionZ;
+  std::vector<float> normalX, normalY, normalZ;
+  std::vector<float> texCoordU, texCoordV;
+
+  size_t size() const { return positionX.size(); }
+  void resize(size_t count);
+  // the interleaved layout back, out has room for size() vertices
+  void interleave(Vertex* out) const;
+};
+
+void convertVerticesScalar(const float* positions, const float* normals, const float* texCoords, size_t count, Vertex* out);
+void convertVertices(const float* positions, const float* normals, const float* texCoords, size_t count, Vertex* out);
+
+// splits three float vectors into three arrays. the stride is 3 floats, only x and y are
+// written when z is null (texture coordinates)
+void deinterleave3Scalar(const float* in, size_t count, float* x, float* y, float* z);
+void deinterleave3(const float* in, size_t count, float* x, float* y, float* z);
+
+void convertVertexStreams(const float* positions, const float* normals, const float* texCoords, size_t count, VertexStreams& out);
+
+// ---- interleaved ------------------------------------------------------------
+
+static inline float* vertexFloats(Vertex* out) {
+  return (float*)out;
+}
+
+void convertVerticesScalar(const float* positions, const float* normals, const float* texCoords, size_t count, Vertex* out) {
+  float* o = vertexFloats(out);
+  for (size_t i = 0; i < count; i++, o += 8) {
+    o[0] = positions[i * 3];
+    o[1] = positions[i * 3 + 1];
+    o[2] = positions[i * 3 + 2];
+    o[3] = normals ? normals[i * 3]     : 0.0f;
+    o[4] = normals ? normals[i * 3 + 1] : 0.0f;
+    o[5] = normals ? normals[i * 3 + 2] : 0.0f;
+    o[6] = texCoords ? texCoords[i * 3]     : 0.0f;
+    o[7] = texCoords ? texCoords[i * 3 + 1] : 0.0f;
+  }
+}
+
+void convertVertices(const float* positions, const float* normals, const float* texCoords, size_t count, Vertex* out) {
+  size_t i = 0;
+  float* o = vertexFloats(out);
+#if defined(__SSE2__)
+  // one vertex a go, each attribute is a 4 float load so the last vertex (whose load
+  // would run past the arrays) is left to the scalar tail
+  if (normals) {
+    for (; i + 1 < count; i++, o += 8) {
+      __m128 p = _mm_loadu_ps(positions + i * 3);
+      __m128 n = _mm_loadu_ps(normals + i * 3);
+      __m128 t = texCoords ? _mm_loadu_ps(texCoords + i * 3) : _mm_setzero_ps();
+      // px py pz nx, then ny nz tu tv
+      __m128 pzNx = _mm_shuffle_ps(p, n, _MM_SHUFFLE(0, 0, 2, 2));
+      _mm_storeu_ps(o,     _mm_shuffle_ps(p, pzNx, _MM_SHUFFLE(2, 0, 1, 0)));
+      _mm_storeu_ps(o + 4, _mm_shuffle_ps(n, t,    _MM_SHUFFLE(1, 0, 2, 1)));
+    }
+  }
+#elif defined(__ARM_NEON)
+  if (normals) {
+    for (; i + 1 < count; i++, o += 8) {
+      float32x4_t p = vld1q_f32(positions + i * 3);
+      float32x4_t n = vld1q_f32(normals + i * 3);
+      float32x2_t t = texCoords ? vld1_f32(texCoords + i * 3) : vdup_n_f32(0.0f);
+      vst1q_f32(o,     vsetq_lane_f32(vgetq_lane_f32(n, 0), p, 3));
+      vst1q_f32(o + 4, vcombine_f32(vget_low_f32(vextq_f32(n, n, 1)), t));
+    }
+  }
+#endif
+  convertVerticesScalar(positions + i * 3, normals ? normals + i * 3 : nullptr,
+      texCoords ? texCoords + i * 3 : nullptr, count - i, (Vertex*)o);
+}
+
+// ---- structure of arrays ----------------------------------------------------
+
+void deinterleave3Scalar(const float* in, size_t count, float* x, float* y, float* z) {
+  for (size_t i = 0; i < count; i++) {
+    x[i] = in[i * 3];
+    y[i] = in[i * 3 + 1];
+    if (z) z[i] = in[i * 3 + 2];
+  }
+}
+
+void deinterleave3(const float* in, size_t count, float* x, float* y, float* z) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  // 4 vectors in 3 loads: x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+  for (; i + 4 <= count; i += 4) {
+    __m128 a = _mm_loadu_ps(in + i * 3);
+    __m128 b = _mm_loadu_ps(in + i * 3 + 4);
+    __m128 c = _mm_loadu_ps(in + i * 3 + 8);
+
+    __m128 x23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+    _mm_storeu_ps(x + i, _mm_shuffle_ps(a, x23, _MM_SHUFFLE(2, 0, 3, 0)));
+
+    __m128 y01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+    __m128 y23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+    _mm_storeu_ps(y + i, _mm_shuffle_ps(y01, y23, _MM_SHUFFLE(2, 0, 2, 0)));
+
+    if (!z) continue;
+    __m128 z01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+    __m128 z23 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+    _mm_storeu_ps(z + i, _mm_shuffle_ps(z01, z23, _MM_SHUFFLE(2, 0, 2, 0)));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 4 <= count; i += 4) {
+    float32x4x3_t v = vld3q_f32(in + i * 3);
+    vst1q_f32(x + i, v.val[0]);
+    vst1q_f32(y + i, v.val[1]);
+    if (z) vst1q_f32(z + i, v.val[2]);
+  }
+#endif
+  deinterleave3Scalar(in + i * 3, count - i, x + i, y + i, z ? z + i : nullptr);
+}
+
+void VertexStreams::resize(size_t count) {
+  for (std::vector<float>* stream : { &positionX, &positionY, &positionZ, &normalX, &normalY, &normalZ, &texCoordU, &texCoordV })
+    stream->resize(count);
+}
+
+void VertexStreams::interleave(Vertex* out) const {
+  float* o = vertexFloats(out);
+  for (size_t i = 0; i < size(); i++, o += 8) {
+    o[0] = positionX[i]; o[1] = positionY[i]; o[2] = positionZ[i];
+    o[3] = normalX[i];   o[4] = normalY[i];   o[5] = normalZ[i];
+    o[6] = texCoordU[i]; o[7] = texCoordV[i];
+  }
+}
+
+void convertVertexStreams(const float* positions, const float* normals, const float* texCoords, size_t count, VertexStreams& out) {
+  out.resize(count);
+  deinterleave3(positions, count, out.positionX.data(), out.positionY.data(), out.positionZ.data());
+
+  if (normals) deinterleave3(normals, count, out.normalX.data(), out.normalY.data(), out.normalZ.data());
+  else for (std::vector<float>* stream : { &out.normalX, &out.normalY, &out.normalZ }) std::fill(stream->begin(), stream->end(), 0.0f);
+
+  if (texCoords) deinterleave3(texCoords, count, out.texCoordU.data(), out.texCoordV.data(), nullptr);
+  else for (std::vector<float>* stream : { &out.texCoordU, &out.texCoordV }) std::fill(stream->begin(), stream->end(), 0.0f);
+}
+
+#endif /* VERTEXCONVERSION_H */
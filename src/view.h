@@ -0,0 +1,19 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <glm/glm.hpp>
+
+// what a draw needs to know about the camera it's being seen through
+struct View {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 position;
+  // in pixels, for turning model space distances into screen space ones
+  float viewportHeight;
+
+  glm::mat4 viewProjection() const { return projection * view; }
+  // pixels covered by one unit at the given distance from the camera
+  float pixelsPerUnit(float distance) const { return projection[1][1] * viewportHeight * 0.5f / distance; }
+};
+
+#endif /* VIEW_H */